@@ -0,0 +1,519 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ChunkScheduler.hpp"
+
+#include "Base/Assert.hpp"
+#include "Base/Math.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+
+uint64_t pack(const int begin, const int end)
+{
+  return (uint64_t(uint32_t(begin)) << 32) | uint64_t(uint32_t(end));
+}
+
+std::pair<int, int> unpack(const uint64_t range)
+{
+  return {int(range >> 32), int(range & 0xffffffff)};
+}
+
+} // namespace
+
+void ChunkScheduler::setMaxNumThreads(const int maxNumThreads)
+{
+  assertRelease(maxNumThreads >= 0, "Invalid number of threads");
+
+  mThreadStates = std::vector<ThreadState>(maxNumThreads);
+  mThreadShares.reserve(maxNumThreads);
+  mNumThreads = maxNumThreads;
+  resetThreadShares();
+}
+
+void ChunkScheduler::setNumThreads(const int numThreads)
+{
+  assertRelease(numThreads >= 0 && numThreads <= int(mThreadStates.size()),
+                "Invalid number of threads");
+
+  mNumThreads = numThreads;
+}
+
+void ChunkScheduler::setMaxNumItems(const int maxNumItems)
+{
+  assertRelease(maxNumItems >= 0, "Invalid number of items");
+
+  // Chunks hold at least one item
+  mChunkCosts.assign(maxNumItems, 0.0);
+  mChunkOrder.resize(maxNumItems);
+}
+
+ChunkScheduler::Mode ChunkScheduler::mode() const { return mMode; }
+void ChunkScheduler::setMode(const Mode mode) { mMode = mode; }
+
+void ChunkScheduler::prepare(const int numItems,
+                             const int chunkSize,
+                             const int minChunkSize)
+{
+  assertRelease(numItems >= 0, "Invalid number of items");
+  assertRelease(chunkSize > 0 && minChunkSize > 0, "Invalid chunk size");
+  assertRelease(numItems <= int(mChunkCosts.size()), "Too many items");
+
+  const auto mode = mMode.load();
+  if (mode != mPreparedMode || mNumThreads != mPreparedNumThreads)
+  {
+    resetThreadShares();
+  }
+  else if (mode == Mode::affinity)
+  {
+    rebalanceThreadShares();
+  }
+  else if (mode == Mode::throughputBalanced)
+  {
+    updateThroughputShares();
+  }
+
+  if (mode != mPreparedMode || chunkSize != mChunkSize)
+  {
+    // Chunks of a different size have unrelated costs
+    resetChunkCosts();
+  }
+
+  mPreparedMode = mode;
+  mPreparedNumThreads = mNumThreads;
+  mNumItems = numItems;
+  mChunkSize = chunkSize;
+  mMinChunkSize = minChunkSize;
+  mNumChunks = (numItems + chunkSize - 1) / chunkSize;
+
+  switch (mPreparedMode)
+  {
+  case Mode::sharedCounter:
+    mNumTakenChunks = 0;
+    break;
+
+  case Mode::workStealing:
+  case Mode::affinity:
+  case Mode::throughputBalanced:
+    seedThreadRanges();
+    break;
+
+  case Mode::guided:
+    mNumTakenItems = 0;
+    break;
+
+  case Mode::costOrdered:
+    sortChunksByCost();
+    mNumTakenChunks = 0;
+    break;
+  }
+}
+
+std::optional<ChunkScheduler::Chunk> ChunkScheduler::take(const int threadIndex)
+{
+  assertRelease(threadIndex >= 0 && threadIndex < mNumThreads,
+                "Invalid thread index");
+
+  std::optional<int> chunkIndex;
+  switch (mPreparedMode)
+  {
+  case Mode::sharedCounter:
+    chunkIndex = takeFromSharedCounter();
+    break;
+
+  case Mode::workStealing:
+    chunkIndex = takeFromOwnRange(threadIndex);
+    if (!chunkIndex)
+    {
+      chunkIndex = steal(threadIndex, false);
+    }
+    break;
+
+  case Mode::affinity:
+  {
+    chunkIndex = takeFromOwnRange(threadIndex);
+    auto& state = mThreadStates[threadIndex];
+    if (!state.hasFinished)
+    {
+      measure(state, chunkIndex);
+    }
+    if (!chunkIndex)
+    {
+      chunkIndex = steal(threadIndex, false);
+    }
+    break;
+  }
+
+  case Mode::throughputBalanced:
+  {
+    auto& state = mThreadStates[threadIndex];
+    chunkIndex = takeFromOwnRange(threadIndex);
+    if (!chunkIndex)
+    {
+      chunkIndex = steal(threadIndex, state.stealsSingleChunks);
+    }
+    measure(state, chunkIndex);
+    break;
+  }
+
+  case Mode::guided:
+    return takeGuided();
+
+  case Mode::costOrdered:
+    chunkIndex = takeByCost(threadIndex);
+    break;
+  }
+
+  return chunkIndex ? std::make_optional(toChunk(*chunkIndex)) : std::nullopt;
+}
+
+void ChunkScheduler::skip(const int threadIndex)
+{
+  assertRelease(threadIndex >= 0 && threadIndex < mNumThreads,
+                "Invalid thread index");
+
+  auto& state = mThreadStates[threadIndex];
+  state.numItems -= state.lastChunkNumItems;
+  state.lastChunkNumItems = 0;
+
+  // A skipped chunk would otherwise be measured as nearly free and sorted last
+  state.chunkIndex = -1;
+}
+
+void ChunkScheduler::resetThreadShares()
+{
+  mThreadShares.assign(mNumThreads, 1.0 / mNumThreads);
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
+  {
+    auto& state = mThreadStates[threadIndex];
+    state.throughput = 0.0;
+    state.stealsSingleChunks = false;
+  }
+}
+
+void ChunkScheduler::seedThreadRanges()
+{
+  double shareBegin = 0.0;
+  int chunkBegin = 0;
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
+  {
+    const auto shareEnd =
+      threadIndex == mNumThreads - 1 ? 1.0 : shareBegin + mThreadShares[threadIndex];
+
+    // Give every thread at least one chunk, if there are enough, so that a thread with
+    // a tiny share is still measured and can win back items when rebalancing.
+    const auto numLaterThreads = mNumThreads - threadIndex - 1;
+    const auto minChunkEnd = std::min(chunkBegin + 1, mNumChunks);
+    const auto maxChunkEnd = std::max(minChunkEnd, mNumChunks - numLaterThreads);
+    const auto chunkEnd =
+      std::clamp(int(std::lround(mNumChunks * shareEnd)), minChunkEnd, maxChunkEnd);
+
+    auto& state = mThreadStates[threadIndex];
+    state.range = pack(chunkBegin, chunkEnd);
+    state.hasStarted = false;
+    state.hasFinished = false;
+    state.numItems = 0;
+    state.lastChunkNumItems = 0;
+
+    shareBegin = shareEnd;
+    chunkBegin = chunkEnd;
+  }
+}
+
+void ChunkScheduler::rebalanceThreadShares()
+{
+  // Durations within this fraction of the longest duration are considered balanced.
+  // Rebalancing more eagerly would move items between threads because of noise.
+  constexpr auto kRebalanceThreshold = 0.2;
+
+  Clock::duration minDuration = Clock::duration::max();
+  Clock::duration maxDuration = Clock::duration::zero();
+  int numMeasuredThreads = 0;
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
+  {
+    const auto& state = mThreadStates[threadIndex];
+
+    // Threads without items, e.g. because there were fewer chunks than threads, have
+    // nothing to measure. Like in updateThroughputShares(), assume average throughput.
+    if (state.numItems == 0)
+    {
+      continue;
+    }
+
+    // Skip rebalancing if a thread didn't render its share, e.g. because it was stolen
+    if (!state.hasFinished || state.duration <= Clock::duration::zero())
+    {
+      return;
+    }
+    minDuration = std::min(minDuration, state.duration);
+    maxDuration = std::max(maxDuration, state.duration);
+    ++numMeasuredThreads;
+  }
+  const auto isBalanced = double((maxDuration - minDuration).count())
+                          <= kRebalanceThreshold * double(maxDuration.count());
+  if (numMeasuredThreads == 0 || (numMeasuredThreads == mNumThreads && isBalanced))
+  {
+    return;
+  }
+
+  double totalThroughput = 0.0;
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
+  {
+    const auto& state = mThreadStates[threadIndex];
+    if (state.numItems != 0)
+    {
+      const auto throughput =
+        state.numItems / std::chrono::duration<double>{state.duration}.count();
+      mThreadShares[threadIndex] = throughput;
+      totalThroughput += throughput;
+    }
+  }
+  const auto averageThroughput = totalThroughput / numMeasuredThreads;
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
+  {
+    if (mThreadStates[threadIndex].numItems == 0)
+    {
+      mThreadShares[threadIndex] = averageThroughput;
+      totalThroughput += averageThroughput;
+    }
+  }
+  for (auto& share : mThreadShares)
+  {
+    share /= totalThroughput;
+  }
+}
+
+void ChunkScheduler::updateThroughputShares()
+{
+  // The weight of the last buffer in the throughput average
+  constexpr auto kSmoothingCoeff = 0.25;
+
+  // Threads slower than this fraction of the fastest thread only steal single chunks
+  constexpr auto kSlowThreadThreshold = 0.5;
+
+  double totalThroughput = 0.0;
+  double maxThroughput = 0.0;
+  int numMeasuredThreads = 0;
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
+  {
+    auto& state = mThreadStates[threadIndex];
+    if (state.hasFinished && state.numItems > 0
+        && state.duration > Clock::duration::zero())
+    {
+      const auto throughput =
+        state.numItems / std::chrono::duration<double>{state.duration}.count();
+      state.throughput = state.throughput > 0.0
+                           ? lerp(state.throughput, throughput, kSmoothingCoeff)
+                           : throughput;
+    }
+
+    if (state.throughput > 0.0)
+    {
+      totalThroughput += state.throughput;
+      maxThroughput = std::max(maxThroughput, state.throughput);
+      ++numMeasuredThreads;
+    }
+  }
+  if (numMeasuredThreads == 0)
+  {
+    return;
+  }
+
+  // Assume average throughput for threads that haven't rendered anything yet
+  const auto averageThroughput = totalThroughput / numMeasuredThreads;
+  totalThroughput += averageThroughput * (mNumThreads - numMeasuredThreads);
+
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
+  {
+    auto& state = mThreadStates[threadIndex];
+    const auto throughput = state.throughput > 0.0 ? state.throughput : averageThroughput;
+    mThreadShares[threadIndex] = throughput / totalThroughput;
+    state.stealsSingleChunks = throughput < kSlowThreadThreshold * maxThroughput;
+  }
+}
+
+void ChunkScheduler::resetChunkCosts()
+{
+  std::fill(mChunkCosts.begin(), mChunkCosts.end(), 0.0);
+  for (auto& state : mThreadStates)
+  {
+    state.chunkIndex = -1;
+  }
+}
+
+void ChunkScheduler::sortChunksByCost()
+{
+  // Chunks that haven't been measured yet, e.g. because they just became live, are
+  // assumed to cost as much as the most expensive chunk so that they start early.
+  double maxCost = 0.0;
+  for (int chunkIndex = 0; chunkIndex < mNumChunks; ++chunkIndex)
+  {
+    maxCost = std::max(maxCost, mChunkCosts[chunkIndex]);
+  }
+  for (int chunkIndex = 0; chunkIndex < mNumChunks; ++chunkIndex)
+  {
+    auto& cost = mChunkCosts[chunkIndex];
+    cost = cost > 0.0 ? cost : maxCost;
+  }
+
+  // A stable sort keeps chunks of equal cost in item order, which is the same order
+  // as the shared counter mode.
+  const auto order = mChunkOrder.begin();
+  std::iota(order, order + mNumChunks, 0);
+  std::stable_sort(order, order + mNumChunks, [&](const int a, const int b) {
+    return mChunkCosts[a] > mChunkCosts[b];
+  });
+}
+
+void ChunkScheduler::measure(ThreadState& state, const std::optional<int>& chunkIndex)
+{
+  if (!state.hasStarted)
+  {
+    state.hasStarted = true;
+    state.startTime = Clock::now();
+  }
+
+  state.lastChunkNumItems = 0;
+  if (chunkIndex)
+  {
+    const auto chunk = toChunk(*chunkIndex);
+    state.lastChunkNumItems = chunk.end - chunk.begin;
+    state.numItems += state.lastChunkNumItems;
+  }
+  else if (!state.hasFinished)
+  {
+    state.hasFinished = true;
+    state.duration = Clock::now() - state.startTime;
+  }
+}
+
+std::optional<int> ChunkScheduler::takeFromSharedCounter()
+{
+  const auto chunkIndex = mNumTakenChunks.fetch_add(1);
+  return chunkIndex < mNumChunks ? std::make_optional(chunkIndex) : std::nullopt;
+}
+
+std::optional<ChunkScheduler::Chunk> ChunkScheduler::takeGuided()
+{
+  const auto numThreads = std::max(mNumThreads, 1);
+  auto numTakenItems = mNumTakenItems.load(std::memory_order_relaxed);
+  while (numTakenItems < mNumItems)
+  {
+    const auto numRemainingItems = mNumItems - numTakenItems;
+    const auto chunkSize =
+      std::max(mMinChunkSize, (numRemainingItems + numThreads - 1) / numThreads);
+    const auto chunkEnd = std::min(numTakenItems + chunkSize, mNumItems);
+    if (mNumTakenItems.compare_exchange_weak(numTakenItems, chunkEnd))
+    {
+      return Chunk{numTakenItems, chunkEnd};
+    }
+  }
+
+  return std::nullopt;
+}
+
+std::optional<int> ChunkScheduler::takeByCost(const int threadIndex)
+{
+  // The weight of the last buffer in the cost average
+  constexpr auto kSmoothingCoeff = 0.25;
+
+  // A chunk ends when its thread takes the next one
+  auto& state = mThreadStates[threadIndex];
+  const auto now = Clock::now();
+  if (state.chunkIndex >= 0)
+  {
+    const auto cost = std::chrono::duration<double>{now - state.chunkStartTime}.count();
+    auto& averageCost = mChunkCosts[state.chunkIndex];
+    averageCost = averageCost > 0.0 ? lerp(averageCost, cost, kSmoothingCoeff) : cost;
+  }
+
+  const auto orderIndex = mNumTakenChunks.fetch_add(1);
+  if (orderIndex >= mNumChunks)
+  {
+    state.chunkIndex = -1;
+    return std::nullopt;
+  }
+
+  state.chunkIndex = mChunkOrder[orderIndex];
+  state.chunkStartTime = now;
+  return state.chunkIndex;
+}
+
+std::optional<int> ChunkScheduler::takeFromOwnRange(const int threadIndex)
+{
+  // The owner takes chunks from the front while thieves take them from the back
+  auto& range = mThreadStates[threadIndex].range;
+  auto packedRange = range.load(std::memory_order_relaxed);
+  while (true)
+  {
+    const auto [begin, end] = unpack(packedRange);
+    if (begin >= end)
+    {
+      return std::nullopt;
+    }
+    if (range.compare_exchange_weak(packedRange, pack(begin + 1, end)))
+    {
+      return begin;
+    }
+  }
+}
+
+std::optional<int> ChunkScheduler::steal(const int threadIndex,
+                                         const bool stealSingleChunk)
+{
+  for (int offset = 1; offset < mNumThreads; ++offset)
+  {
+    auto& victimRange = mThreadStates[(threadIndex + offset) % mNumThreads].range;
+    auto packedRange = victimRange.load(std::memory_order_relaxed);
+    while (true)
+    {
+      const auto [begin, end] = unpack(packedRange);
+      if (begin >= end)
+      {
+        break;
+      }
+
+      const auto numStolenChunks = stealSingleChunk ? 1 : (end - begin + 1) / 2;
+      const auto stolenBegin = end - numStolenChunks;
+      if (victimRange.compare_exchange_weak(packedRange, pack(begin, stolenBegin)))
+      {
+        // Thieves leave empty ranges alone, so the thread's own range can be replaced
+        // without a compare-exchange.
+        mThreadStates[threadIndex].range = pack(stolenBegin + 1, end);
+        return stolenBegin;
+      }
+    }
+  }
+
+  return std::nullopt;
+}
+
+ChunkScheduler::Chunk ChunkScheduler::toChunk(const int chunkIndex) const
+{
+  const auto begin = chunkIndex * mChunkSize;
+  return {begin, std::min(begin + mChunkSize, mNumItems)};
+}
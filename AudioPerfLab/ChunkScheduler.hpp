@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "Base/Config.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/*! Hands out chunks of a buffer's work items to processing threads.
+ *
+ * Items are identified by their index in [0, numItems). Thread shares and chunk costs
+ * belong to item indices, so an item should keep its index across buffers. All methods
+ * except take() must be called while no thread is taking chunks.
+ */
+class ChunkScheduler
+{
+  using Clock = std::chrono::high_resolution_clock;
+
+public:
+  enum class Mode
+  {
+    //! All threads take chunks in order from a single shared counter
+    sharedCounter,
+
+    /*! Each thread starts with its own range of chunks and steals half of another
+     * thread's remaining chunks when it runs out.
+     */
+    workStealing,
+
+    /*! Like workStealing, but threads keep the same share of items across buffers so
+     * that the items' state stays in their caches.
+     *
+     * Shares are only rebalanced, in proportion to each thread's measured throughput,
+     * when the time threads spend on their own shares diverges.
+     */
+    affinity,
+
+    /*! Like workStealing, but each thread's share is proportional to its throughput
+     * averaged over recent buffers.
+     *
+     * Threads on slower cores, e.g. efficiency cores, get smaller shares and steal only
+     * one chunk at a time so that they don't end up rendering a large tail of the buffer.
+     */
+    throughputBalanced,
+
+    /*! Threads take chunks from a shared counter, but chunk sizes shrink with the
+     * remaining work.
+     *
+     * Each chunk holds the remaining items divided by the number of threads, but at least
+     * the minimum chunk size. Early chunks are large to reduce overhead and late chunks
+     * are small so that threads finish at about the same time.
+     */
+    guided,
+
+    /*! Threads take chunks from a shared counter in order of decreasing cost.
+     *
+     * The cost of each chunk is the time it took to render in recent buffers. Starting
+     * the most expensive chunks first leaves the cheap ones to fill the gaps at the end
+     * of the buffer, which shortens the time until the last thread finishes.
+     */
+    costOrdered,
+  };
+
+  //! A range of item indices
+  struct Chunk
+  {
+    int begin;
+    int end;
+  };
+
+  //! Allocate state for up to maxNumThreads threads and use all of them
+  void setMaxNumThreads(int maxNumThreads);
+
+  //! Use only the first numThreads threads. Real-time safe.
+  void setNumThreads(int numThreads);
+
+  //! Allocate state for buffers with up to maxNumItems items
+  void setMaxNumItems(int maxNumItems);
+
+  Mode mode() const;
+  void setMode(Mode mode);
+
+  /*! Distribute numItems items among threads for the next buffer.
+   *
+   * Chunks hold chunkSize items, or between minChunkSize and numItems / numThreads items
+   * in guided mode.
+   */
+  void prepare(int numItems, int chunkSize, int minChunkSize);
+
+  /*! Forget the measured costs of cost-ordered mode.
+   *
+   * Costs belong to chunk indices, so they must be reset when items change their
+   * indices.
+   */
+  void resetChunkCosts();
+
+  //! Take the next chunk for a thread, or nothing if all chunks have been taken
+  std::optional<Chunk> take(int threadIndex);
+
+  /*! Exclude the chunk last taken by a thread from the measurements, e.g. because the
+   * thread skipped it instead of rendering it.
+   */
+  void skip(int threadIndex);
+
+private:
+  struct alignas(kCacheLineSize) ThreadState
+  {
+    //! A range of chunk indices packed into one word so that it can be updated atomically
+    std::atomic<uint64_t> range{0};
+
+    /* Measurements of the current buffer, only written by the thread itself. Affinity
+     * mode measures the thread's own range, throughput balancing all of its work.
+     */
+    bool hasStarted{false};
+    bool hasFinished{false};
+    Clock::time_point startTime{};
+    Clock::duration duration{};
+    int numItems{0};
+    //! The number of items of the last chunk added to numItems
+    int lastChunkNumItems{0};
+
+    //! Recent items per second, or zero if not measured yet
+    double throughput{0.0};
+    bool stealsSingleChunks{false};
+
+    //! The chunk being rendered in cost-ordered mode, or -1 if none
+    int chunkIndex{-1};
+    Clock::time_point chunkStartTime{};
+  };
+
+  void resetThreadShares();
+  void seedThreadRanges();
+  void rebalanceThreadShares();
+  void updateThroughputShares();
+  void sortChunksByCost();
+  void measure(ThreadState& state, const std::optional<int>& chunkIndex);
+
+  std::optional<int> takeFromSharedCounter();
+  std::optional<Chunk> takeGuided();
+  std::optional<int> takeByCost(int threadIndex);
+  std::optional<int> takeFromOwnRange(int threadIndex);
+  std::optional<int> steal(int threadIndex, bool stealSingleChunk);
+  Chunk toChunk(int chunkIndex) const;
+
+  std::atomic<Mode> mMode{Mode::sharedCounter};
+  Mode mPreparedMode{Mode::sharedCounter};
+  int mNumThreads{0};
+  int mPreparedNumThreads{0};
+  int mNumItems{0};
+  int mChunkSize{1};
+  int mMinChunkSize{1};
+  int mNumChunks{0};
+  alignas(kCacheLineSize) std::atomic<int> mNumTakenChunks{0};
+  alignas(kCacheLineSize) std::atomic<int> mNumTakenItems{0};
+  std::vector<ThreadState> mThreadStates;
+  //! The fraction of all chunks initially assigned to each thread
+  std::vector<double> mThreadShares;
+  //! The recent render time of each chunk in seconds, or zero if not measured yet
+  std::vector<double> mChunkCosts;
+  //! The chunk indices in the order they are taken in cost-ordered mode
+  std::vector<int> mChunkOrder;
+};
@@ -36,12 +36,16 @@ constexpr auto kAmpSmoothingDuration = std::chrono::milliseconds{100};
  *   sine waves but rather heavyweight items like synthesizers and audio effects.
  * - It forces worker threads to do a minimum amount of processing, provoking dropouts if
  *   workers are running slow.
- * - It avoids contention on the ParallelSineBank::mNumTakenPartials atomic.
+ * - It avoids contention on the ChunkScheduler::mNumTakenChunks atomic.
  */
 constexpr auto kNumPartialsPerProcessingChunk = 256;
 
 constexpr auto kChordNoteNumbers = {53.0f, 56.0f, 60.0f, 65.0f};
 constexpr auto kNumUnrandomizedPhases = 15;
 
+// The layout of the session rendered by SessionGraph, which plays the chord once
+constexpr auto kNumSessionGraphTracks = 16;
+constexpr auto kNumSessionGraphBuses = 4;
+
 constexpr auto kDriveMeasurementQueueSize = 1024;
 constexpr auto kMaxNumFrames = 4096;
@@ -28,19 +28,93 @@
 struct DriveMeasurement
 {
   double hostTime;
+  // Seconds spent rendering the buffer
   double duration;
+  // Seconds spent in the most recent audio I/O callback. Equals the duration unless
+  // pipelined, in which case the callback only hands out the previously rendered buffer.
+  double callbackDuration;
+  // Seconds from the start of the callback that started rendering the most recently
+  // delivered buffer until it was delivered
+  double outputLatency;
   int numFrames;
   int cpuNumbers[MAX_NUM_THREADS];
   int numActivePartialsProcessed[MAX_NUM_THREADS];
+  // Seconds from the start of the buffer until each worker thread started processing,
+  // or -1 for threads that aren't workers
+  double workerWakeupLatencies[MAX_NUM_THREADS];
+  int numWorkersWokenWhileSpinning;
+  // Threads that rendered this buffer, which is fewer than the number of processing
+  // threads if the worker governor parked some
+  int numProcessingThreads;
+  // Active partials skipped because the processing threads ran out of time. Only
+  // non-zero if partial shedding is on.
+  int numShedPartials;
+  // The quality governor's limit on active partials, or -1 if they aren't limited
+  int maxNumActivePartials;
+  // Missed deadlines of the driver since it was created
+  int numMissedDeadlines;
   float inputPeakLevel;
 };
 
+// The stages of rendering a buffer in seconds since the callback started, or since the
+// pipeline thread started rendering when pipelined. Stages that didn't happen are -1.
+struct RenderTraceMeasurement
+{
+  double renderStart;
+  double renderStartedEnd;
+  // Per thread index: when workers stopped waiting for the buffer, and when each thread
+  // started and finished processing. The driver thread has no wake time.
+  double threadWakeTimes[MAX_NUM_THREADS];
+  double threadProcessStartTimes[MAX_NUM_THREADS];
+  double threadProcessEndTimes[MAX_NUM_THREADS];
+  // All processing threads have finished
+  double processEnd;
+  // The buffer is mixed
+  double renderEndedEnd;
+  double callbackEnd;
+  int numProcessingThreads;
+};
+
+struct OfflineRenderMeasurement
+{
+  int numFrames;
+  int numBuffers;
+  // Seconds spent rendering, not including writing the WAV file
+  double renderDuration;
+  double framesPerSecond;
+  // Active partials times frames, per second
+  double partialFramesPerSecond;
+  double meanBufferDuration;
+  double maxBufferDuration;
+};
+
 typedef NS_ENUM(NSInteger, PerformancePreset) {
   standardPreset,
   optimalPreset,
   customPreset,
 };
 
+typedef NS_ENUM(NSInteger, SineKernel) {
+  referenceSineKernel,
+  vectorizedSineKernel,
+  quadratureSineKernel,
+  harmonicStackSineKernel,
+};
+
+typedef NS_ENUM(NSInteger, ChunkScheduling) {
+  sharedCounterChunkScheduling,
+  workStealingChunkScheduling,
+  affinityChunkScheduling,
+  throughputBalancedChunkScheduling,
+  guidedChunkScheduling,
+  costOrderedChunkScheduling,
+};
+
+typedef NS_ENUM(NSInteger, WorkerDispatch) {
+  semaphoreWorkerDispatch,
+  forkJoinBarrierWorkerDispatch,
+};
+
 @interface Engine : NSObject
 
 @property(nonatomic) PerformancePreset preset;
@@ -56,11 +130,32 @@ typedef NS_ENUM(NSInteger, PerformancePreset) {
 @property(nonatomic) bool processInDriverThread;
 @property(nonatomic) bool isWorkIntervalOn;
 @property(nonatomic) double minimumLoad;
+@property(nonatomic) double workerSpinDuration;
+@property(nonatomic) WorkerDispatch workerDispatch;
+@property(nonatomic) bool isWorkerGovernorOn;
+@property(nonatomic) bool isDemandWakeupOn;
+@property(nonatomic) bool isPipelined;
 @property(nonatomic) int numSines;
+@property(nonatomic) bool isSessionGraphOn;
+@property(nonatomic) bool isPartialSheddingOn;
+@property(nonatomic) bool isQualityGovernorOn;
 @property(nonatomic, readonly) int maxNumSines;
+@property(nonatomic) SineKernel sineKernel;
+@property(nonatomic) int renderTileSize;
+@property(nonatomic) ChunkScheduling chunkScheduling;
+@property(nonatomic) int minChunkSize;
 
 - (void)setOutputVolume:(float)outputVolume fadeDuration:(double)fadeDuration;
 - (void)playSineBurstFor:(double)duration additionalSines:(int)numAdditionalSines;
 - (void)fetchMeasurements:(void (^)(struct DriveMeasurement))callback;
+- (void)fetchRenderTraces:(void (^)(struct RenderTraceMeasurement))callback;
+
+/*! Render duration seconds of audio as fast as possible instead of in real-time.
+ *
+ * Live audio pauses while rendering. If wavFilePath isn't nil, the output is written
+ * there. All fields of the result are zero if an error occurs.
+ */
+- (struct OfflineRenderMeasurement)renderOfflineFor:(double)duration
+                                        wavFilePath:(NSString*)wavFilePath;
 
 @end
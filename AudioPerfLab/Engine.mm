@@ -25,10 +25,13 @@
 #include "Constants.hpp"
 #include "ParallelSineBank.hpp"
 #include "Partial.hpp"
+#include "QualityGovernor.hpp"
+#include "SessionGraph.hpp"
 
 #include "Base/Assert.hpp"
 #include "Base/AudioHost.hpp"
 #include "Base/BusyThreads.hpp"
+#include "Base/CycleCounter.hpp"
 #include "Base/Driver.hpp"
 #include "Base/FixedSPSCQueue.hpp"
 #include "Base/Math.hpp"
@@ -42,6 +45,9 @@
 #include <chrono>
 #include <cmath>
 #include <optional>
+#include <os/log.h>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -131,6 +137,143 @@ PerformancePreset configToPreset(const PerformanceConfig& config,
   }
 }
 
+ParallelSineBank::Kernel toSineBankKernel(const SineKernel kernel)
+{
+  switch (kernel)
+  {
+  case referenceSineKernel:
+    return ParallelSineBank::Kernel::reference;
+
+  case vectorizedSineKernel:
+    return ParallelSineBank::Kernel::vectorized;
+
+  case quadratureSineKernel:
+    return ParallelSineBank::Kernel::quadrature;
+
+  case harmonicStackSineKernel:
+    return ParallelSineBank::Kernel::harmonicStack;
+  }
+}
+
+SineKernel toSineKernel(const ParallelSineBank::Kernel kernel)
+{
+  switch (kernel)
+  {
+  case ParallelSineBank::Kernel::reference:
+    return referenceSineKernel;
+
+  case ParallelSineBank::Kernel::vectorized:
+    return vectorizedSineKernel;
+
+  case ParallelSineBank::Kernel::quadrature:
+    return quadratureSineKernel;
+
+  case ParallelSineBank::Kernel::harmonicStack:
+    return harmonicStackSineKernel;
+  }
+}
+
+ChunkScheduler::Mode toChunkSchedulerMode(const ChunkScheduling scheduling)
+{
+  switch (scheduling)
+  {
+  case sharedCounterChunkScheduling:
+    return ChunkScheduler::Mode::sharedCounter;
+
+  case workStealingChunkScheduling:
+    return ChunkScheduler::Mode::workStealing;
+
+  case affinityChunkScheduling:
+    return ChunkScheduler::Mode::affinity;
+
+  case throughputBalancedChunkScheduling:
+    return ChunkScheduler::Mode::throughputBalanced;
+
+  case guidedChunkScheduling:
+    return ChunkScheduler::Mode::guided;
+
+  case costOrderedChunkScheduling:
+    return ChunkScheduler::Mode::costOrdered;
+  }
+}
+
+ChunkScheduling toChunkScheduling(const ChunkScheduler::Mode mode)
+{
+  switch (mode)
+  {
+  case ChunkScheduler::Mode::sharedCounter:
+    return sharedCounterChunkScheduling;
+
+  case ChunkScheduler::Mode::workStealing:
+    return workStealingChunkScheduling;
+
+  case ChunkScheduler::Mode::affinity:
+    return affinityChunkScheduling;
+
+  case ChunkScheduler::Mode::throughputBalanced:
+    return throughputBalancedChunkScheduling;
+
+  case ChunkScheduler::Mode::guided:
+    return guidedChunkScheduling;
+
+  case ChunkScheduler::Mode::costOrdered:
+    return costOrderedChunkScheduling;
+  }
+}
+
+AudioHost::WorkerDispatch toAudioHostWorkerDispatch(const WorkerDispatch dispatch)
+{
+  switch (dispatch)
+  {
+  case semaphoreWorkerDispatch:
+    return AudioHost::WorkerDispatch::semaphores;
+
+  case forkJoinBarrierWorkerDispatch:
+    return AudioHost::WorkerDispatch::forkJoinBarrier;
+  }
+}
+
+WorkerDispatch toWorkerDispatch(const AudioHost::WorkerDispatch dispatch)
+{
+  switch (dispatch)
+  {
+  case AudioHost::WorkerDispatch::semaphores:
+    return semaphoreWorkerDispatch;
+
+  case AudioHost::WorkerDispatch::forkJoinBarrier:
+    return forkJoinBarrierWorkerDispatch;
+  }
+}
+
+RenderTraceMeasurement toRenderTraceMeasurement(const AudioHost::RenderTrace& trace)
+{
+  static_assert(kMaxNumTracedThreads >= MAX_NUM_THREADS, "Not all threads are traced");
+
+  const auto startTime =
+    trace.callbackStartTime != 0 ? trace.callbackStartTime : trace.renderStartTime;
+  const auto toSeconds = [&](const uint64_t time) {
+    return time != 0 ? cycleCounterTicksToSeconds(time - startTime).count() : -1.0;
+  };
+
+  RenderTraceMeasurement measurement{};
+  measurement.renderStart = toSeconds(trace.renderStartTime);
+  measurement.renderStartedEnd = toSeconds(trace.renderStartedEndTime);
+  for (int threadIndex = 0; threadIndex < MAX_NUM_THREADS; ++threadIndex)
+  {
+    const auto& threadTrace = trace.threadTraces[threadIndex];
+    measurement.threadWakeTimes[threadIndex] = toSeconds(threadTrace.wakeTime);
+    measurement.threadProcessStartTimes[threadIndex] =
+      toSeconds(threadTrace.processStartTime);
+    measurement.threadProcessEndTimes[threadIndex] =
+      toSeconds(threadTrace.processEndTime);
+  }
+  measurement.processEnd = toSeconds(trace.processEndTime);
+  measurement.renderEndedEnd = toSeconds(trace.renderEndedEndTime);
+  measurement.callbackEnd = toSeconds(trace.callbackEndTime);
+  measurement.numProcessingThreads = trace.threads.numProcessingThreads;
+  return measurement;
+}
+
 } // namespace
 
 class EngineImpl
@@ -139,16 +282,20 @@ class EngineImpl
 
 public:
   EngineImpl()
-    : mHost{[&](const int numProcessingThreads) { setup(numProcessingThreads); },
-            [&](const StereoAudioBufferPtrs ioBuffer, const int numFrames) {
-              renderStarted(ioBuffer, numFrames);
+    : mHost{[&](const int maxNumProcessingThreads) { setup(maxNumProcessingThreads); },
+            [&](const StereoAudioBufferPtrs ioBuffer,
+                const int numFrames,
+                const AudioHost::ProcessingThreads& threads) {
+              renderStarted(ioBuffer, numFrames, threads);
             },
-            [&](const int threadIndex, const int numFrames) {
-              process(threadIndex, numFrames);
+            [&](const int threadIndex, const int numFrames, const Deadline& deadline) {
+              process(threadIndex, numFrames, deadline);
             },
             [&](const StereoAudioBufferPtrs ioBuffer,
                 const uint64_t hostTime,
-                const int numFrames) { renderEnded(ioBuffer, hostTime, numFrames); }}
+                const int numFrames) { renderEnded(ioBuffer, hostTime, numFrames); },
+            [&](const int numFrames) { return estimateWork(numFrames); },
+            [&](const int numFrames) { beginBuffer(numFrames); }}
   {
     const auto numChordsToMaxOutSystem =
       estimateNumChordsToMaxOutSystem(mHost.workgroup());
@@ -157,10 +304,16 @@ public:
     const auto effectiveNumUnrandomizedPhases =
       kNumUnrandomizedPhases * numChordsToMaxOutSystem;
 
-    const auto chordPartials =
+    const auto chord =
       generateChord(mHost.driver().sampleRate(), kAmpSmoothingDuration,
                     duplicateChord(kChordNoteNumbers, numChordsToMaxOutSystem));
-    mSineBank.setPartials(randomizePhases(chordPartials, effectiveNumUnrandomizedPhases));
+    mSineBank.setPartials(
+      randomizePhases(toPartials(chord), effectiveNumUnrandomizedPhases));
+    mSineBank.setHarmonicStacks(randomizePhases(chord, effectiveNumUnrandomizedPhases));
+    mSessionGraph.setup(toPartials(generateChord(mHost.driver().sampleRate(),
+                                                 kAmpSmoothingDuration,
+                                                 duplicateChord(kChordNoteNumbers, 1))),
+                        kNumSessionGraphTracks, kNumSessionGraphBuses);
     mHost.start();
   }
 
@@ -180,7 +333,21 @@ public:
   int numSines() const { return mNumSines; }
   void setNumSines(const int numSines) { mNumSines = numSines; }
 
-  int maxNumSines() const { return int(mSineBank.partials().size()); }
+  int maxNumSines() const { return mSineBank.numPartials(); }
+
+  bool isQualityGovernorOn() const { return mIsQualityGovernorOn; }
+  void setIsQualityGovernorOn(const bool isOn) { mIsQualityGovernorOn = isOn; }
+
+  bool isPartialSheddingOn() const { return mIsPartialSheddingOn; }
+  void setIsPartialSheddingOn(const bool isOn) { mIsPartialSheddingOn = isOn; }
+
+  bool isSessionGraphOn() const { return mIsSessionGraphOn; }
+  void setIsSessionGraphOn(const bool isOn) { mIsSessionGraphOn = isOn; }
+
+  bool isDemandWakeupOn() const { return mIsDemandWakeupOn; }
+  void setIsDemandWakeupOn(const bool isOn) { mIsDemandWakeupOn = isOn; }
+
+  ParallelSineBank& sineBank() { return mSineBank; }
 
   void playSineBurst(const double duration, const int numAdditionalSines)
   {
@@ -188,6 +355,43 @@ public:
     mSineBurstDuration = duration;
   }
 
+  OfflineRenderMeasurement renderOffline(const double duration,
+                                         const std::optional<std::string>& wavFilePath)
+  {
+    // Stop so that no real-time buffers are counted before reading the result
+    mHost.stop();
+
+    mNumPartialFramesRendered = 0;
+    OfflineRenderMeasurement measurement{};
+    try
+    {
+      const auto stats = mHost.renderOffline(
+        int(std::lround(duration * mHost.driver().sampleRate())), wavFilePath);
+
+      const auto numBuffers = int(stats.bufferDurations.size());
+      const auto renderDuration = stats.renderDuration().count();
+      measurement.numFrames = stats.numFrames;
+      measurement.numBuffers = numBuffers;
+      measurement.renderDuration = renderDuration;
+      measurement.framesPerSecond = stats.framesPerSecond();
+      measurement.partialFramesPerSecond =
+        renderDuration > 0.0 ? mNumPartialFramesRendered / renderDuration : 0.0;
+      measurement.meanBufferDuration = numBuffers > 0 ? renderDuration / numBuffers : 0.0;
+      measurement.maxBufferDuration =
+        numBuffers > 0
+          ? std::max_element(stats.bufferDurations.begin(), stats.bufferDurations.end())
+              ->count()
+          : 0.0;
+    }
+    catch (const std::runtime_error& exception)
+    {
+      os_log_error(OS_LOG_DEFAULT, "Offline render failed: %s", exception.what());
+    }
+
+    mHost.start();
+    return measurement;
+  }
+
   std::optional<DriveMeasurement> popDriveMeasurement()
   {
     const auto* pMeasurement = mDriveMeasurements.front();
@@ -196,6 +400,12 @@ public:
     return result;
   }
 
+  std::optional<RenderTraceMeasurement> popRenderTrace()
+  {
+    const auto trace = mHost.popRenderTrace();
+    return trace ? std::make_optional(toRenderTraceMeasurement(*trace)) : std::nullopt;
+  }
+
 private:
   void addDriveMeasurement(const uint64_t hostTime,
                            const std::chrono::time_point<Clock> bufferStartTime,
@@ -207,42 +417,119 @@ private:
     driveMeasurement.hostTime = machAbsoluteTimeToSeconds(hostTime).count();
     driveMeasurement.duration =
       std::chrono::duration<double>{bufferEndTime - bufferStartTime}.count();
+    const auto callbackTiming = mHost.lastCallbackTiming();
+    driveMeasurement.callbackDuration = callbackTiming.callbackDuration.count();
+    driveMeasurement.outputLatency = callbackTiming.outputLatency.count();
     driveMeasurement.numFrames = numFrames;
     std::copy(mNumActivePartialsProcessed.begin(), mNumActivePartialsProcessed.end(),
               driveMeasurement.numActivePartialsProcessed);
     std::copy(mCpuNumbers.begin(), mCpuNumbers.end(), driveMeasurement.cpuNumbers);
+    std::fill(std::begin(driveMeasurement.workerWakeupLatencies),
+              std::end(driveMeasurement.workerWakeupLatencies), -1.0);
+    for (int threadIndex = 1; threadIndex <= mProcessingThreads.numWorkerThreads();
+         ++threadIndex)
+    {
+      const auto wakeup = mHost.workerWakeup(threadIndex);
+      driveMeasurement.workerWakeupLatencies[threadIndex] = wakeup.latency.count();
+      driveMeasurement.numWorkersWokenWhileSpinning += wakeup.wasSpinning ? 1 : 0;
+    }
+    driveMeasurement.numProcessingThreads = mProcessingThreads.numProcessingThreads;
+    driveMeasurement.numShedPartials = mSineBank.numShedPartials();
+    const auto maxNumActivePartials = mQualityGovernor.maxNumActivePartials();
+    driveMeasurement.maxNumActivePartials =
+      mWasQualityGovernorOn && maxNumActivePartials ? *maxNumActivePartials : -1;
+    driveMeasurement.numMissedDeadlines = int(mHost.driver().numMissedDeadlines());
     driveMeasurement.inputPeakLevel = inputPeakLevel;
     mDriveMeasurements.tryPushBack(driveMeasurement);
   }
 
   // Called with no audio threads active after app launch and setting changes
-  void setup(const int numProcessingThreads)
+  void setup(const int maxNumProcessingThreads)
   {
     assertRelease(
-      numProcessingThreads > 0 && (numProcessingThreads + 1) <= MAX_NUM_THREADS,
+      maxNumProcessingThreads > 0 && (maxNumProcessingThreads + 1) <= MAX_NUM_THREADS,
       "Invalid number of threads");
 
-    mSineBank.setNumThreads(numProcessingThreads);
+    mSineBank.setMaxNumThreads(maxNumProcessingThreads);
     std::fill(mNumActivePartialsProcessed.begin(), mNumActivePartialsProcessed.end(), -1);
     std::fill(mCpuNumbers.begin(), mCpuNumbers.end(), -1);
   }
 
-  // Called at the start of the audio I/O callback with no worker threads active
-  void renderStarted(StereoAudioBufferPtrs, const int numFrames)
+  // Called at the start of the audio I/O callback before estimating the work
+  void beginBuffer(int)
   {
-    mRenderStartTime = Clock::now();
-
     if (const auto duration = mSineBurstDuration.exchange(0.0f))
     {
       mNumSineBurstSamplesRemaining = float(mHost.driver().sampleRate()) * duration;
     }
 
-    const auto effectiveNumSines =
+    mEffectiveNumSines =
       mNumSines.load()
       + (mNumSineBurstSamplesRemaining > 0 ? mNumAdditionalSinesInBurst.load() : 0);
-    mSineBank.prepare(effectiveNumSines, numFrames);
 
-    if (!mHost.processInDriverThread())
+    const auto isQualityGovernorOn = mIsQualityGovernorOn.load();
+    if (isQualityGovernorOn && !mWasQualityGovernorOn)
+    {
+      mQualityGovernor.reset();
+    }
+    mWasQualityGovernorOn = isQualityGovernorOn;
+    if (const auto maxNumActivePartials = mQualityGovernor.maxNumActivePartials();
+        isQualityGovernorOn && maxNumActivePartials)
+    {
+      mEffectiveNumSines = std::min(mEffectiveNumSines, *maxNumActivePartials);
+    }
+  }
+
+  // Called after beginBuffer() to choose the number of processing threads. The worker
+  // governor uses the estimate even if demand wakeup is off.
+  std::optional<AudioHost::WorkEstimate> estimateWork(int) const
+  {
+    // Each chunk of partials is rendered by a single thread, so more threads than chunks
+    // would only wait for the others.
+    return AudioHost::WorkEstimate{
+      std::clamp(mEffectiveNumSines, 0, mSineBank.numPartials()),
+      kNumPartialsPerProcessingChunk, mIsDemandWakeupOn};
+  }
+
+  // Called at the start of the audio I/O callback with no worker threads active
+  void renderStarted(StereoAudioBufferPtrs,
+                     const int numFrames,
+                     const AudioHost::ProcessingThreads& threads)
+  {
+    mRenderStartTime = Clock::now();
+
+    // The number of threads can change between buffers, so clear the measurements of
+    // threads that may have been parked.
+    if (threads.numProcessingThreads != mProcessingThreads.numProcessingThreads
+        || threads.processInDriverThread != mProcessingThreads.processInDriverThread)
+    {
+      std::fill(
+        mNumActivePartialsProcessed.begin(), mNumActivePartialsProcessed.end(), -1);
+      std::fill(mCpuNumbers.begin(), mCpuNumbers.end(), -1);
+    }
+    mProcessingThreads = threads;
+    mSineBank.setNumThreads(threads.numProcessingThreads);
+    mSineBank.prepare(mEffectiveNumSines, numFrames);
+    mIsSheddingPartials = mIsPartialSheddingOn;
+
+    // Fade the graph in and out instead of switching it abruptly, and keep rendering it
+    // until it has faded out
+    const bool isSessionGraphOn = mIsSessionGraphOn;
+    if (isSessionGraphOn != mWasSessionGraphOn)
+    {
+      const auto fadeDuration = std::chrono::duration<double>{kAmpSmoothingDuration};
+      mSessionGraph.fadeTo(
+        isSessionGraphOn ? 1.0f : 0.0f,
+        int(std::lround(fadeDuration.count() * mHost.driver().sampleRate())));
+      mWasSessionGraphOn = isSessionGraphOn;
+    }
+    mIsSessionGraphRendered = isSessionGraphOn || mSessionGraph.isFading();
+    if (mIsSessionGraphRendered)
+    {
+      mSessionGraph.prepare(numFrames);
+    }
+
+    if (!threads.processInDriverThread)
     {
       mNumActivePartialsProcessed[0] = -1;
       mCpuNumbers[0] = cpuNumber();
@@ -251,12 +538,16 @@ private:
 
   // Called by the main audio I/O thread (if processing in the driver thread is enabled)
   // and by worker threads
-  void process(const int threadIndex, const int numFrames)
+  void process(const int threadIndex, const int numFrames, const Deadline& deadline)
   {
     const auto processingThreadIndex =
-      threadIndex - (host().processInDriverThread() ? 0 : 1);
-    mNumActivePartialsProcessed[threadIndex] =
-      mSineBank.process(processingThreadIndex, numFrames);
+      threadIndex - (mProcessingThreads.processInDriverThread ? 0 : 1);
+    mNumActivePartialsProcessed[threadIndex] = mSineBank.process(
+      processingThreadIndex, numFrames, mIsSheddingPartials ? deadline : Deadline{});
+    if (mIsSessionGraphRendered)
+    {
+      mSessionGraph.process(processingThreadIndex);
+    }
     mCpuNumbers[threadIndex] = cpuNumber();
   }
 
@@ -266,21 +557,42 @@ private:
                    const int numFrames)
   {
     const auto inputPeakLevel = peakLevel(ioBuffer, numFrames);
+    for (const int numPartials : mNumActivePartialsProcessed)
+    {
+      mNumPartialFramesRendered += std::max(numPartials, 0) * int64_t(numFrames);
+    }
     std::fill_n(ioBuffer[0], numFrames, 0.0f);
     std::fill_n(ioBuffer[1], numFrames, 0.0f);
 
     mSineBank.mixTo(ioBuffer, numFrames);
+    if (mIsSessionGraphRendered)
+    {
+      mSessionGraph.mixTo(ioBuffer, numFrames);
+    }
 
     mNumSineBurstSamplesRemaining =
       std::max<int>(0, mNumSineBurstSamplesRemaining - numFrames);
 
     const auto endTime = Clock::now();
     addDriveMeasurement(hostTime, mRenderStartTime, endTime, numFrames, inputPeakLevel);
+
+    if (mWasQualityGovernorOn)
+    {
+      const auto bufferDuration =
+        QualityGovernor::Seconds{numFrames / mHost.driver().sampleRate()};
+      mQualityGovernor.update(endTime - mRenderStartTime, bufferDuration,
+                              std::clamp(mEffectiveNumSines, 0, mSineBank.numPartials()));
+    }
   }
 
   AudioHost mHost;
+  AudioHost::ProcessingThreads mProcessingThreads;
   BusyThreads mBusyThreads;
   ParallelSineBank mSineBank;
+  SessionGraph mSessionGraph;
+  std::atomic<bool> mIsSessionGraphOn{false};
+  bool mWasSessionGraphOn{false};
+  bool mIsSessionGraphRendered{false};
   Clock::time_point mRenderStartTime;
   FixedSPSCQueue<DriveMeasurement> mDriveMeasurements{kDriveMeasurementQueueSize};
   std::atomic<int> mNumSines{-1};
@@ -288,9 +600,18 @@ private:
   std::atomic<int> mNumAdditionalSinesInBurst{0};
   std::atomic<float> mSineBurstDuration{0.0f};
   int mNumSineBurstSamplesRemaining{0};
+  int mEffectiveNumSines{0};
+  std::atomic<bool> mIsDemandWakeupOn{false};
+  std::atomic<bool> mIsPartialSheddingOn{false};
+  std::atomic<bool> mIsQualityGovernorOn{false};
+  //! Only used by the audio I/O thread
+  QualityGovernor mQualityGovernor;
+  bool mWasQualityGovernorOn{false};
+  bool mIsSheddingPartials{false};
 
   std::array<std::atomic<int>, MAX_NUM_THREADS> mNumActivePartialsProcessed{};
   std::array<std::atomic<int>, MAX_NUM_THREADS> mCpuNumbers{};
+  int64_t mNumPartialFramesRendered{0};
 };
 
 @implementation Engine
@@ -366,11 +687,68 @@ private:
 - (double)minimumLoad { return mEngine.host().minimumLoad(); }
 - (void)setMinimumLoad:(double)minimumLoad { mEngine.host().setMinimumLoad(minimumLoad); }
 
+- (double)workerSpinDuration { return mEngine.host().workerSpinDuration().count(); }
+- (void)setWorkerSpinDuration:(double)duration
+{
+  mEngine.host().setWorkerSpinDuration(std::chrono::duration<double>{duration});
+}
+
+- (WorkerDispatch)workerDispatch
+{
+  return toWorkerDispatch(mEngine.host().workerDispatch());
+}
+- (void)setWorkerDispatch:(WorkerDispatch)dispatch
+{
+  mEngine.host().setWorkerDispatch(toAudioHostWorkerDispatch(dispatch));
+}
+
+- (bool)isWorkerGovernorOn { return mEngine.host().isWorkerGovernorOn(); }
+- (void)setIsWorkerGovernorOn:(bool)isOn { mEngine.host().setIsWorkerGovernorOn(isOn); }
+
+- (bool)isQualityGovernorOn { return mEngine.isQualityGovernorOn(); }
+- (void)setIsQualityGovernorOn:(bool)isOn { mEngine.setIsQualityGovernorOn(isOn); }
+
+- (bool)isPartialSheddingOn { return mEngine.isPartialSheddingOn(); }
+- (void)setIsPartialSheddingOn:(bool)isOn { mEngine.setIsPartialSheddingOn(isOn); }
+
+- (bool)isSessionGraphOn { return mEngine.isSessionGraphOn(); }
+- (void)setIsSessionGraphOn:(bool)isOn { mEngine.setIsSessionGraphOn(isOn); }
+
+- (bool)isDemandWakeupOn { return mEngine.isDemandWakeupOn(); }
+- (void)setIsDemandWakeupOn:(bool)isOn { mEngine.setIsDemandWakeupOn(isOn); }
+
+- (bool)isPipelined { return mEngine.host().isPipelined(); }
+- (void)setIsPipelined:(bool)isPipelined { mEngine.host().setIsPipelined(isPipelined); }
+
 - (int)numSines { return mEngine.numSines(); }
 - (void)setNumSines:(int)numSines { mEngine.setNumSines(numSines); }
 
 - (int)maxNumSines { return mEngine.maxNumSines(); }
 
+- (SineKernel)sineKernel { return toSineKernel(mEngine.sineBank().kernel()); }
+- (void)setSineKernel:(SineKernel)sineKernel
+{
+  mEngine.sineBank().setKernel(toSineBankKernel(sineKernel));
+}
+
+- (int)renderTileSize { return mEngine.sineBank().tileSize(); }
+- (void)setRenderTileSize:(int)numFrames { mEngine.sineBank().setTileSize(numFrames); }
+
+- (ChunkScheduling)chunkScheduling
+{
+  return toChunkScheduling(mEngine.sineBank().scheduler().mode());
+}
+- (void)setChunkScheduling:(ChunkScheduling)chunkScheduling
+{
+  mEngine.sineBank().scheduler().setMode(toChunkSchedulerMode(chunkScheduling));
+}
+
+- (int)minChunkSize { return mEngine.sineBank().minChunkSize(); }
+- (void)setMinChunkSize:(int)numPartials
+{
+  mEngine.sineBank().setMinChunkSize(numPartials);
+}
+
 - (void)playSineBurstFor:(double)duration additionalSines:(int)numAdditionalSines
 {
   mEngine.playSineBurst(duration, numAdditionalSines);
@@ -384,4 +762,20 @@ private:
   }
 }
 
+- (void)fetchRenderTraces:(void (^)(struct RenderTraceMeasurement))callback
+{
+  while (const auto maybeTrace = mEngine.popRenderTrace())
+  {
+    callback(*maybeTrace);
+  }
+}
+
+- (struct OfflineRenderMeasurement)renderOfflineFor:(double)duration
+                                        wavFilePath:(NSString*)wavFilePath
+{
+  return mEngine.renderOffline(
+    duration, wavFilePath ? std::make_optional<std::string>(wavFilePath.UTF8String)
+                          : std::nullopt);
+}
+
 @end
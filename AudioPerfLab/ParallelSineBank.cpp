@@ -23,22 +23,244 @@
 #include "ParallelSineBank.hpp"
 
 #include "Base/Assert.hpp"
+#include "Base/Thread.hpp"
 #include "Constants.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+
+using Clock = std::chrono::high_resolution_clock;
+
+using BlockProcessor = void (*)(PartialBlock&, int, StereoAudioBufferPtrs);
+
+BlockProcessor blockProcessor(const ParallelSineBank::Kernel kernel)
+{
+  switch (kernel)
+  {
+  case ParallelSineBank::Kernel::reference:
+    return processPartialBlockReference;
+
+  case ParallelSineBank::Kernel::vectorized:
+    return processPartialBlock;
+
+  case ParallelSineBank::Kernel::quadrature:
+    return processPartialBlockQuadrature;
+
+  case ParallelSineBank::Kernel::harmonicStack:
+    break;
+  }
+
+  fatalError("Harmonic stacks aren't rendered as partial blocks");
+}
+
+/*! Render a block while fading it out to silence within numFrames.
+ *
+ * The fade is much faster than the block's amplitude smoothing, so that it finishes
+ * within one buffer. Targets and smoothing are restored afterwards, so the block fades
+ * back in when it's rendered normally again.
+ */
+void fadeOutPartialBlock(const BlockProcessor processBlock,
+                         PartialBlock& block,
+                         const int numFrames,
+                         const StereoAudioBufferPtrs output)
+{
+  // The remaining amplitude at the end of the fade, relative to the start (-60 dB)
+  constexpr auto kFadeOutEndGain = 0.001f;
+
+  const auto targetAmp = block.targetAmp;
+  const auto ampSmoothingCoeff = block.ampSmoothingCoeff;
+  block.targetAmp.fill(0.0f);
+  block.ampSmoothingCoeff.fill(1.0f - std::pow(kFadeOutEndGain, 1.0f / float(numFrames)));
+  processBlock(block, numFrames, output);
+  block.targetAmp = targetAmp;
+  block.ampSmoothingCoeff = ampSmoothingCoeff;
+  block.amp.fill(0.0f);
+}
+
+bool usesHarmonicStacks(const ParallelSineBank::Kernel kernel)
+{
+  return kernel == ParallelSineBank::Kernel::harmonicStack;
+}
+
+void simulateSlowdown(const double factor, const Clock::time_point chunkStartTime)
+{
+  if (factor > 1.0)
+  {
+    const auto now = Clock::now();
+    const auto end = now + std::chrono::duration_cast<Clock::duration>(
+                             (now - chunkStartTime) * (factor - 1.0));
+    while (Clock::now() < end)
+    {
+      hardwareDelay();
+    }
+  }
+}
+
+} // namespace
+
+void ParallelSineBank::LiveSet::reset(const int numItems)
+{
+  mIndices.clear();
+  mIndices.reserve(numItems);
+  mContains.assign(numItems, false);
+  mIsSorted = true;
+}
+
+void ParallelSineBank::LiveSet::insert(const int index)
+{
+  if (!mContains[index])
+  {
+    mIsSorted = mIsSorted && (mIndices.empty() || mIndices.back() < index);
+    mIndices.push_back(index);
+    mContains[index] = true;
+  }
+}
+
+template <typename IsSilent>
+void ParallelSineBank::LiveSet::prune(IsSilent isSilent)
+{
+  const auto isRemoved = [&](const int index) {
+    if (isSilent(index))
+    {
+      mContains[index] = false;
+      return true;
+    }
+    return false;
+  };
+  mIndices.erase(
+    std::remove_if(mIndices.begin(), mIndices.end(), isRemoved), mIndices.end());
+
+  if (!mIsSorted)
+  {
+    std::sort(mIndices.begin(), mIndices.end());
+    mIsSorted = true;
+  }
+}
+
+const std::vector<int>& ParallelSineBank::LiveSet::indices() const { return mIndices; }
+
+std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator>
+ParallelSineBank::LiveSet::find(const int begin, const int end) const
+{
+  const auto first = std::lower_bound(mIndices.begin(), mIndices.end(), begin);
+  return {first, std::lower_bound(first, mIndices.end(), end)};
+}
+
+int ParallelSineBank::LiveSet::end() const
+{
+  return mIndices.empty() ? 0 : mIndices.back() + 1;
+}
+
+void ParallelSineBank::setMaxNumThreads(const int maxNumThreads)
+{
+  assertRelease(maxNumThreads >= 0, "Invalid number of threads");
+
+  mBuffers.resize(maxNumThreads,
+                  StereoAudioBuffer{std::vector<float>(kMaxNumFrames, 0.0f),
+                                    std::vector<float>(kMaxNumFrames, 0.0f)});
+  mNumReducedChildren = std::vector<std::atomic<int>>(maxNumThreads);
+  mScheduler.setMaxNumThreads(maxNumThreads);
+  mSlowdownFactors = std::vector<std::atomic<double>>(maxNumThreads);
+  for (auto& factor : mSlowdownFactors)
+  {
+    factor = 1.0;
+  }
+  mNumThreads = maxNumThreads;
+}
+
+int ParallelSineBank::numThreads() const { return mNumThreads; }
 
 void ParallelSineBank::setNumThreads(const int numThreads)
 {
-  assertRelease(numThreads >= 0, "Invalid number of threads");
+  assertRelease(numThreads >= 0 && numThreads <= int(mBuffers.size()),
+                "Invalid number of threads");
+
+  mNumThreads = numThreads;
+  mScheduler.setNumThreads(numThreads);
+}
+
+ParallelSineBank::Kernel ParallelSineBank::kernel() const { return mKernel; }
+void ParallelSineBank::setKernel(const Kernel kernel) { mKernel = kernel; }
+
+int ParallelSineBank::tileSize() const { return mTileSize; }
+void ParallelSineBank::setTileSize(const int numFrames)
+{
+  assertRelease(numFrames > 0, "Invalid tile size");
+  mTileSize = numFrames;
+}
+
+ChunkScheduler& ParallelSineBank::scheduler() { return mScheduler; }
+
+int ParallelSineBank::minChunkSize() const { return mMinChunkSize; }
+void ParallelSineBank::setMinChunkSize(const int numPartials)
+{
+  assertRelease(numPartials > 0, "Invalid chunk size");
+  mMinChunkSize = numPartials;
+}
+
+double ParallelSineBank::slowdownFactor(const int threadIndex) const
+{
+  assertRelease(threadIndex >= 0 && threadIndex < int(mSlowdownFactors.size()),
+                "Invalid thread index");
+  return mSlowdownFactors[threadIndex];
+}
+void ParallelSineBank::setSlowdownFactor(const int threadIndex, const double factor)
+{
+  assertRelease(threadIndex >= 0 && threadIndex < int(mSlowdownFactors.size()),
+                "Invalid thread index");
+  assertRelease(factor >= 1.0, "Invalid slowdown factor");
+  mSlowdownFactors[threadIndex] = factor;
+}
 
-  mBuffers.resize(numThreads, StereoAudioBuffer{std::vector<float>(kMaxNumFrames, 0.0f),
-                                                std::vector<float>(kMaxNumFrames, 0.0f)});
+int ParallelSineBank::numPartials() const { return mNumPartials; }
+void ParallelSineBank::setPartials(const std::vector<Partial>& partials)
+{
+  mBlocks = makePartialBlocks(partials);
+  mNumPartials = int(partials.size());
+  mLiveBlocks.reset(int(mBlocks.size()));
+  mBlockAmps.assign(mBlocks.size(), 0.0f);
+  mSortedBlockAmps.reserve(mBlocks.size());
+  mScheduler.setMaxNumItems(std::max(int(mBlocks.size()), int(mStacks.size())));
+  mNeedsActivePartialsReset = true;
 }
 
-const std::vector<Partial>& ParallelSineBank::partials() const { return mPartials; }
-void ParallelSineBank::setPartials(std::vector<Partial> partials)
+void ParallelSineBank::setHarmonicStacks(std::vector<HarmonicStack> stacks)
 {
-  mPartials = std::move(partials);
+  struct Harmonic
+  {
+    HarmonicLocation location;
+    float phaseIncrement;
+  };
+
+  std::vector<Harmonic> harmonics;
+  for (size_t stackIndex = 0; stackIndex < stacks.size(); ++stackIndex)
+  {
+    const auto& stack = stacks[stackIndex];
+    for (size_t harmonicIndex = 0; harmonicIndex < stack.amp.size(); ++harmonicIndex)
+    {
+      harmonics.push_back({{int(stackIndex), int(harmonicIndex)},
+                           stack.phaseIncrement * float(harmonicIndex + 1)});
+    }
+  }
+  std::sort(harmonics.begin(), harmonics.end(), [](const auto& a, const auto& b) {
+    return a.phaseIncrement < b.phaseIncrement;
+  });
+
+  mPartialHarmonics.clear();
+  for (const auto& harmonic : harmonics)
+  {
+    mPartialHarmonics.push_back(harmonic.location);
+  }
+
+  mStacks = std::move(stacks);
+  mNumActiveHarmonics.assign(mStacks.size(), 0);
+  mLiveStacks.reset(int(mStacks.size()));
+  mScheduler.setMaxNumItems(std::max(int(mBlocks.size()), int(mStacks.size())));
+  mNeedsActivePartialsReset = true;
 }
 
 void ParallelSineBank::prepare(const int numActivePartials, const int numFrames)
@@ -46,63 +268,351 @@ void ParallelSineBank::prepare(const int numActivePartials, const int numFrames)
   assertRelease(numActivePartials >= 0, "Invalid number of active partials");
   assertRelease(numFrames > 0 && numFrames <= kMaxNumFrames, "Invalid number of frames");
 
-  mNumActivePartials = numActivePartials;
-  mNumTakenPartials = 0;
+  Kernel kernel = mKernel;
+  int numTargetPartials = std::min(numActivePartials, mNumPartials);
+  if (!mNeedsActivePartialsReset
+      && usesHarmonicStacks(kernel) != usesHarmonicStacks(mPreparedKernel))
+  {
+    // Keep rendering the outgoing representation with all partials deactivated until it
+    // has faded out, so that switching between blocks and stacks doesn't click
+    const auto& outgoingLiveSet =
+      usesHarmonicStacks(mPreparedKernel) ? mLiveStacks : mLiveBlocks;
+    if (!outgoingLiveSet.indices().empty())
+    {
+      kernel = mPreparedKernel;
+      numTargetPartials = 0;
+    }
+  }
+
+  if (mNeedsActivePartialsReset
+      || usesHarmonicStacks(kernel) != usesHarmonicStacks(mPreparedKernel))
+  {
+    resetActivePartials(kernel);
+    mNeedsActivePartialsReset = false;
 
-  for (auto& stereoBuffer : mBuffers)
+    // Costs of blocks don't say anything about stacks and vice versa
+    mScheduler.resetChunkCosts();
+  }
+  mPreparedKernel = kernel;
+  mPreparedTileSize = mTileSize;
+  mNumShedPartials = 0;
+
+  updateActivePartials(numTargetPartials);
+  if (!usesHarmonicStacks(kernel))
+  {
+    rankBlocksByAmplitude();
+  }
+
+  // The scheduler hands out ranges of block or stack indices rather than positions in
+  // the live set, so that a thread's share and the measured cost of a chunk stay with
+  // the same items when others start or stop being live. Processing threads skip the
+  // items of a range that aren't live. Items are activated in order of frequency, so
+  // there are few of those.
+  if (usesHarmonicStacks(kernel))
+  {
+    // A stack holds all harmonics of a saw, which is already comparable to a chunk of
+    // partials, so chunks hold one stack. Guided mode still starts with larger chunks.
+    mScheduler.prepare(mLiveStacks.end(), 1, 1);
+  }
+  else
+  {
+    constexpr auto kNumBlocksPerChunk =
+      kNumPartialsPerProcessingChunk / kPartialBlockSize;
+    static_assert(kNumPartialsPerProcessingChunk % kPartialBlockSize == 0,
+                  "Chunks must consist of whole partial blocks");
+    const auto minNumBlocksPerChunk =
+      (mMinChunkSize + kPartialBlockSize - 1) / kPartialBlockSize;
+    mScheduler.prepare(mLiveBlocks.end(), kNumBlocksPerChunk, minNumBlocksPerChunk);
+  }
+  for (int threadIndex = 0; threadIndex < mNumThreads; ++threadIndex)
   {
+    mNumReducedChildren[threadIndex] = 0;
+
+    auto& stereoBuffer = mBuffers[threadIndex];
     std::fill_n(stereoBuffer[0].begin(), numFrames, 0.0f);
     std::fill_n(stereoBuffer[1].begin(), numFrames, 0.0f);
   }
 }
 
-int ParallelSineBank::process(const int threadIndex, const int numFrames)
+int ParallelSineBank::process(const int threadIndex,
+                              const int numFrames,
+                              const Deadline& deadline)
 {
   assertRelease(
-    threadIndex >= 0 && threadIndex < int(mBuffers.size()), "Invalid thread index");
+    threadIndex >= 0 && threadIndex < mNumThreads, "Invalid thread index");
   assertRelease(numFrames > 0 && numFrames <= kMaxNumFrames, "Invalid number of frames");
 
   auto& stereoBuffer = mBuffers[threadIndex];
+  const auto numActivePartialsProcessed = usesHarmonicStacks(mPreparedKernel)
+                                   ? processStacks(threadIndex, numFrames, stereoBuffer)
+                                   : processBlocks(
+                                       threadIndex, numFrames, deadline, stereoBuffer);
+
+  reduce(threadIndex, numFrames);
+
+  return numActivePartialsProcessed;
+}
+
+int ParallelSineBank::numShedPartials() const { return mNumShedPartials; }
+
+void ParallelSineBank::mixTo(const StereoAudioBufferPtrs dest, const int numFrames)
+{
+  assertRelease(numFrames > 0 && numFrames <= kMaxNumFrames, "Invalid number of frames");
 
+  if (mNumThreads == 0)
+  {
+    return;
+  }
+
+  const auto& sum = mBuffers.front();
+  for (int channel = 0; channel < 2; ++channel)
+  {
+    std::transform(sum[channel].begin(), sum[channel].begin() + numFrames, dest[channel],
+                   dest[channel], [](const float x, const float y) { return x + y; });
+  }
+}
+
+void ParallelSineBank::resetActivePartials(const Kernel kernel)
+{
+  // The representation that's about to be rendered hasn't been updated since it was last
+  // used, so fade it in from silence instead of resuming with stale amplitudes.
+  if (usesHarmonicStacks(kernel))
+  {
+    for (auto& stack : mStacks)
+    {
+      std::fill(stack.targetAmp.begin(), stack.targetAmp.end(), 0.0f);
+      std::fill(stack.amp.begin(), stack.amp.end(), 0.0f);
+    }
+    std::fill(mNumActiveHarmonics.begin(), mNumActiveHarmonics.end(), 0);
+    mLiveStacks.reset(int(mStacks.size()));
+  }
+  else
+  {
+    for (auto& block : mBlocks)
+    {
+      block.targetAmp.fill(0.0f);
+      block.amp.fill(0.0f);
+    }
+    mLiveBlocks.reset(int(mBlocks.size()));
+  }
+
+  mNumActivePartials = 0;
+}
+
+void ParallelSineBank::updateActivePartials(const int numActivePartials)
+{
+  const int prevNumActivePartials = mNumActivePartials;
+  for (int partialIndex = numActivePartials; partialIndex < prevNumActivePartials;
+       ++partialIndex)
+  {
+    setPartialActive(partialIndex, false);
+  }
+  for (int partialIndex = prevNumActivePartials; partialIndex < numActivePartials;
+       ++partialIndex)
+  {
+    setPartialActive(partialIndex, true);
+  }
+  mNumActivePartials = numActivePartials;
+
+  // Drop items once they have faded out. Only live items are visited, and the fade of a
+  // deactivated partial was rendered by the workers of the previous buffer.
+  if (usesHarmonicStacks(mPreparedKernel))
+  {
+    mLiveStacks.prune([&](const int index) { return isSilent(mStacks[index]); });
+  }
+  else
+  {
+    mLiveBlocks.prune([&](const int index) { return isSilent(mBlocks[index]); });
+  }
+}
+
+void ParallelSineBank::setPartialActive(const int partialIndex, const bool isActive)
+{
+  if (usesHarmonicStacks(mPreparedKernel))
+  {
+    const auto [stackIndex, harmonicIndex] = mPartialHarmonics[partialIndex];
+    auto& stack = mStacks[stackIndex];
+    stack.targetAmp[harmonicIndex] = isActive ? stack.ampWhenActive[harmonicIndex] : 0.0f;
+    mNumActiveHarmonics[stackIndex] += isActive ? 1 : -1;
+    mLiveStacks.insert(stackIndex);
+  }
+  else
+  {
+    const auto blockIndex = partialIndex / kPartialBlockSize;
+    const auto lane = partialIndex % kPartialBlockSize;
+    auto& block = mBlocks[blockIndex];
+    block.targetAmp[lane] = isActive ? block.ampWhenActive[lane] : 0.0f;
+    mLiveBlocks.insert(blockIndex);
+  }
+}
+
+void ParallelSineBank::rankBlocksByAmplitude()
+{
+  // Shedding more than this fraction of the live blocks would remove audible parts of
+  // the sound rather than detail
+  constexpr auto kMaxShedFraction = 0.5;
+
+  mSortedBlockAmps.clear();
+  for (const auto blockIndex : mLiveBlocks.indices())
+  {
+    const auto& block = mBlocks[blockIndex];
+    const auto amp = std::max(*std::max_element(block.amp.begin(), block.amp.end()),
+                              *std::max_element(block.targetAmp.begin(),
+                                                block.targetAmp.end()));
+    mBlockAmps[blockIndex] = amp;
+    mSortedBlockAmps.push_back(amp);
+  }
+
+  // Blocks strictly quieter than the block at this rank can be shed
+  const auto maxNumShedBlocks = int(double(mSortedBlockAmps.size()) * kMaxShedFraction);
+  if (maxNumShedBlocks == 0)
+  {
+    mMaxShedBlockAmp = 0.0f;
+    return;
+  }
+  const auto rank = mSortedBlockAmps.begin() + maxNumShedBlocks;
+  std::nth_element(mSortedBlockAmps.begin(), rank, mSortedBlockAmps.end());
+  mMaxShedBlockAmp = *rank;
+}
+
+int ParallelSineBank::processBlocks(const int threadIndex,
+                                    const int numFrames,
+                                    const Deadline& deadline,
+                                    StereoAudioBuffer& output)
+{
+  const auto processBlock = blockProcessor(mPreparedKernel);
+  const auto tileSize = mPreparedTileSize;
+
+  const auto numActivePartials = mNumActivePartials.load();
+  const auto slowdown = mSlowdownFactors[threadIndex].load();
   int numActivePartialsProcessed = 0;
-  int partialStartIndex = 0;
-  while ((partialStartIndex = mNumTakenPartials.fetch_add(kNumPartialsPerProcessingChunk))
-         < int(mPartials.size()))
-  {
-    const int partialEndIndex =
-      std::min(partialStartIndex + kNumPartialsPerProcessingChunk, int(mPartials.size()));
-    for (int partialIndex = partialStartIndex; partialIndex < partialEndIndex;
-         ++partialIndex)
+  int numShedPartials = 0;
+  bool isShedding = false;
+  while (const auto chunk = mScheduler.take(threadIndex))
+  {
+    const auto chunkStartTime = Clock::now();
+    const auto [chunkBegin, chunkEnd] = mLiveBlocks.find(chunk->begin, chunk->end);
+
+    // Keep taking chunks after the deadline so that all of them are counted, but skip
+    // the quiet blocks. Skipped blocks resume with the same phase.
+    isShedding = isShedding || chunkStartTime >= deadline.time();
+    const auto isShed = [&](const int blockIndex) {
+      return isShedding && mBlockAmps[blockIndex] < mMaxShedBlockAmp;
+    };
+
+    bool hasSkippedBlocks = false;
+    for (auto it = chunkBegin; it != chunkEnd; ++it)
     {
-      auto& partial = mPartials[partialIndex];
-      if (partialIndex < mNumActivePartials)
+      const auto numBlockPartials =
+        std::clamp(numActivePartials - *it * kPartialBlockSize, 0, kPartialBlockSize);
+      if (!isShed(*it))
+      {
+        numActivePartialsProcessed += numBlockPartials;
+        continue;
+      }
+
+      numShedPartials += numBlockPartials;
+      auto& block = mBlocks[*it];
+      if (isMuted(block))
       {
-        partial.targetAmp = partial.ampWhenActive;
-        ++numActivePartialsProcessed;
+        hasSkippedBlocks = true;
       }
       else
       {
-        partial.targetAmp = 0.0f;
+        // Dropping an audible block would click
+        fadeOutPartialBlock(
+          processBlock, block, numFrames, {output[0].data(), output[1].data()});
+      }
+    }
+
+    // Render all blocks of the chunk into one tile of the output before moving on to the
+    // next tile so that the tile stays in the L1 cache.
+    for (int tileStartFrame = 0; tileStartFrame < numFrames; tileStartFrame += tileSize)
+    {
+      const auto numTileFrames = std::min(tileSize, numFrames - tileStartFrame);
+      const StereoAudioBufferPtrs tile{
+        output[0].data() + tileStartFrame, output[1].data() + tileStartFrame};
+      for (auto it = chunkBegin; it != chunkEnd; ++it)
+      {
+        if (!isShed(*it))
+        {
+          processBlock(mBlocks[*it], numTileFrames, tile);
+        }
       }
-      processPartial(partial, numFrames, stereoBuffer);
     }
+
+    // A chunk with skipped blocks would be measured as cheaper than it is
+    if (hasSkippedBlocks)
+    {
+      mScheduler.skip(threadIndex);
+    }
+
+    simulateSlowdown(slowdown, chunkStartTime);
+  }
+
+  if (numShedPartials > 0)
+  {
+    mNumShedPartials.fetch_add(numShedPartials, std::memory_order_relaxed);
   }
 
   return numActivePartialsProcessed;
 }
 
-void ParallelSineBank::mixTo(const StereoAudioBufferPtrs dest, const int numFrames)
+int ParallelSineBank::processStacks(const int threadIndex,
+                                    const int numFrames,
+                                    StereoAudioBuffer& output)
 {
-  assertRelease(numFrames > 0 && numFrames <= kMaxNumFrames, "Invalid number of frames");
+  const auto slowdown = mSlowdownFactors[threadIndex].load();
+  int numActivePartialsProcessed = 0;
+  while (const auto chunk = mScheduler.take(threadIndex))
+  {
+    const auto chunkStartTime = Clock::now();
+    const auto [chunkBegin, chunkEnd] = mLiveStacks.find(chunk->begin, chunk->end);
+    for (auto it = chunkBegin; it != chunkEnd; ++it)
+    {
+      const auto stackIndex = *it;
+      numActivePartialsProcessed += mNumActiveHarmonics[stackIndex];
+      processHarmonicStack(
+        mStacks[stackIndex], numFrames, {output[0].data(), output[1].data()});
+    }
 
-  const auto sumInto = [](const auto& inBuffer, auto* pOutBuffer, const int numFrames) {
-    std::transform(inBuffer.begin(), inBuffer.begin() + numFrames, pOutBuffer, pOutBuffer,
-                   [](const float x, const float y) { return x + y; });
-  };
+    simulateSlowdown(slowdown, chunkStartTime);
+  }
 
-  for (const auto& buffer : mBuffers)
+  return numActivePartialsProcessed;
+}
+
+void ParallelSineBank::reduce(const int threadIndex, const int numFrames)
+{
+  // Sum the thread buffers pairwise in a binary tree whose root is the first buffer. At
+  // each node the thread that finishes last adds the right buffer to the left one and
+  // moves up, so no thread ever waits for another and the serial part is limited to
+  // log2(numThreads) buffer additions.
+  const auto numThreads = mNumThreads;
+  int index = threadIndex;
+  for (int stride = 1; stride < numThreads; stride *= 2)
   {
-    sumInto(buffer[0], dest[0], numFrames);
-    sumInto(buffer[1], dest[1], numFrames);
+    const auto leftIndex = index & ~(2 * stride - 1);
+    const auto rightIndex = leftIndex + stride;
+    if (rightIndex >= numThreads)
+    {
+      continue;
+    }
+
+    // Nodes are identified by their right child, which is unique across all levels
+    if (mNumReducedChildren[rightIndex].fetch_add(1, std::memory_order_acq_rel) == 0)
+    {
+      return;
+    }
+
+    auto& left = mBuffers[leftIndex];
+    const auto& right = mBuffers[rightIndex];
+    for (int channel = 0; channel < 2; ++channel)
+    {
+      std::transform(left[channel].begin(), left[channel].begin() + numFrames,
+                     right[channel].begin(), left[channel].begin(),
+                     [](const float x, const float y) { return x + y; });
+    }
+    index = leftIndex;
   }
 }
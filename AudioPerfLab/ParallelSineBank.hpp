@@ -23,27 +23,197 @@
 #pragma once
 
 #include "AudioBuffer.hpp"
+#include "ChunkScheduler.hpp"
+#include "Constants.hpp"
 #include "Partial.hpp"
 
+#include "Base/Deadline.hpp"
+
 #include <array>
 #include <atomic>
+#include <utility>
 #include <vector>
 
 class ParallelSineBank
 {
 public:
+  enum class Kernel
+  {
+    //! Render each partial with std::sin(), one partial at a time
+    reference,
+
+    //! Render several partials at once using SIMD instructions
+    vectorized,
+
+    //! Like vectorized, but generate sines with a complex rotation instead of sin()
+    quadrature,
+
+    //! Render whole sawtooth waves at once, deriving harmonics with a recurrence
+    harmonicStack,
+  };
+
+  //! Allocate buffers for up to maxNumThreads threads and use all of them
+  void setMaxNumThreads(int maxNumThreads);
+
+  /*! The number of threads rendering the next buffer.
+   *
+   * Can be changed between buffers from the audio thread without allocating, up to the
+   * maximum passed to setMaxNumThreads().
+   */
+  int numThreads() const;
   void setNumThreads(int numThreads);
 
-  const std::vector<Partial>& partials() const;
-  void setPartials(std::vector<Partial> partials);
+  /*! The kernel used to render partials.
+   *
+   * When switching between partial blocks and harmonic stacks, the current representation
+   * fades out before the other one fades in.
+   */
+  Kernel kernel() const;
+  void setKernel(Kernel kernel);
+
+  /*! The number of frames rendered for all partial blocks of a chunk before moving on to
+   * the next frames.
+   *
+   * Smaller tiles keep the output in the L1 cache when rendering large buffers, but add
+   * per-tile overhead. Tile sizes of at least the buffer size disable tiling. Harmonic
+   * stacks are always rendered untiled.
+   */
+  int tileSize() const;
+  void setTileSize(int numFrames);
+
+  //! The scheduler distributing partial blocks or stacks among threads
+  ChunkScheduler& scheduler();
+
+  /*! The smallest number of partials taken at a time by ChunkScheduler::Mode::guided.
+   *
+   * Rounded up to whole partial blocks. Harmonic stacks ignore it: guided mode takes at
+   * least one stack at a time, and the other modes exactly one.
+   */
+  int minChunkSize() const;
+  void setMinChunkSize(int numPartials);
+
+  /*! Simulate a slower core by stretching the time a thread spends on each chunk.
+   *
+   * A factor of 2 makes a thread take twice as long. This allows testing load balancing
+   * on systems without efficiency cores. Factors are reset by setMaxNumThreads().
+   */
+  double slowdownFactor(int threadIndex) const;
+  void setSlowdownFactor(int threadIndex, double factor);
+
+  int numPartials() const;
+  void setPartials(const std::vector<Partial>& partials);
+
+  /*! Set the stacks rendered by Kernel::harmonicStack.
+   *
+   * The stacks should contain the same partials passed to setPartials(). Partials are
+   * activated in order of frequency for both representations.
+   */
+  void setHarmonicStacks(std::vector<HarmonicStack> stacks);
 
+  /*! Prepare rendering of the next buffer.
+   *
+   * Only partials whose active state changed since the last call are updated. Partials
+   * that are silent and not fading are skipped entirely by process().
+   */
   void prepare(int numActivePartials, int numFrames);
-  int process(int threadIndex, int numFrames);
+
+  /*! Render a share of the partials and reduce the per-thread buffers.
+   *
+   * Must be called once per buffer for each of the threads passed to setNumThreads().
+   * After rendering, threads combine their buffers pairwise without waiting for each
+   * other. Returns the number of active partials rendered.
+   *
+   * Once the deadline has expired, the quietest partial blocks are shed from the
+   * remaining chunks and counted by numShedPartials(). Blocks are ranked by amplitude in
+   * prepare(), and only the quieter half of them can be shed, so which partials are lost
+   * doesn't depend on the order in which the scheduler hands out chunks. A block that
+   * was audible is faded out within the first buffer it's shed from, and fades back in
+   * once it's rendered again. Harmonic stacks are never shed because each of them is a
+   * whole note.
+   */
+  int process(int threadIndex, int numFrames, const Deadline& deadline = {});
+
+  //! The number of active partials skipped by process() in the current buffer
+  int numShedPartials() const;
+
+  //! Add the output reduced by process() to dest
   void mixTo(StereoAudioBufferPtrs dest, int numFrames);
 
 private:
-  std::vector<Partial> mPartials;
+  /*! The indices of blocks or stacks that have active partials or are still fading out.
+   *
+   * Indices are kept in ascending order. Storage for all items is reserved up front so
+   * that updating the set doesn't allocate on the audio thread.
+   */
+  class LiveSet
+  {
+  public:
+    void reset(int numItems);
+    void insert(int index);
+
+    //! Remove all items for which isSilent(index) returns true
+    template <typename IsSilent>
+    void prune(IsSilent isSilent);
+
+    const std::vector<int>& indices() const;
+
+    //! The live indices in [begin, end)
+    std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator> find(
+      int begin, int end) const;
+
+    //! One past the largest live index, or 0 if no item is live
+    int end() const;
+
+  private:
+    std::vector<int> mIndices;
+    std::vector<bool> mContains;
+    bool mIsSorted{true};
+  };
+
+  struct HarmonicLocation
+  {
+    int stackIndex;
+    int harmonicIndex;
+  };
+
+  void resetActivePartials(Kernel kernel);
+  void updateActivePartials(int numActivePartials);
+  void setPartialActive(int partialIndex, bool isActive);
+  void rankBlocksByAmplitude();
+
+  int processBlocks(int threadIndex,
+                    int numFrames,
+                    const Deadline& deadline,
+                    StereoAudioBuffer& output);
+  int processStacks(int threadIndex, int numFrames, StereoAudioBuffer& output);
+  void reduce(int threadIndex, int numFrames);
+
+  std::vector<PartialBlock> mBlocks;
+  int mNumPartials{0};
+  std::vector<HarmonicStack> mStacks;
+  //! The stack and harmonic of each partial when all partials are sorted by frequency
+  std::vector<HarmonicLocation> mPartialHarmonics;
+  std::vector<int> mNumActiveHarmonics;
+  LiveSet mLiveBlocks;
+  //! The peak current or target amplitude of each live block
+  std::vector<float> mBlockAmps;
+  //! Live blocks quieter than this can be shed
+  float mMaxShedBlockAmp{0.0f};
+  //! Storage for ranking live blocks by amplitude without allocating
+  std::vector<float> mSortedBlockAmps;
+  LiveSet mLiveStacks;
+  bool mNeedsActivePartialsReset{true};
   std::vector<StereoAudioBuffer> mBuffers;
+  int mNumThreads{0};
+  std::atomic<Kernel> mKernel{Kernel::vectorized};
+  Kernel mPreparedKernel{Kernel::vectorized};
+  std::atomic<int> mTileSize{kMaxNumFrames};
+  int mPreparedTileSize{kMaxNumFrames};
   std::atomic<int> mNumActivePartials{0};
-  std::atomic<int> mNumTakenPartials{0};
+  std::atomic<int> mNumShedPartials{0};
+  ChunkScheduler mScheduler;
+  std::atomic<int> mMinChunkSize{kPartialBlockSize};
+  std::vector<std::atomic<double>> mSlowdownFactors;
+  //! The number of children of each reduction tree node that have finished
+  std::vector<std::atomic<int>> mNumReducedChildren;
 };
@@ -25,62 +25,259 @@
 #include "Base/Math.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <random>
+#include <tuple>
+#include <utility>
+
+namespace
+{
 
 constexpr auto kTwoPi = float(M_PI * 2.0);
 
-std::vector<Partial> generateSaw(const float sampleRate,
-                                 const float amp,
-                                 const std::chrono::duration<float> ampSmoothingDuration,
-                                 const float pan,
-                                 const float frequency)
+bool isAudible(const float amp)
 {
-  std::vector<Partial> result;
+  const auto kSilenceThreshold = 0.00001f;
+  return std::fabs(amp) > kSilenceThreshold;
+}
+
+//! Wrap a phase into [0, 2pi)
+float wrapPhase(const float phase)
+{
+  const auto wrapped = std::fmod(phase, kTwoPi);
+  return wrapped < 0.0f ? wrapped + kTwoPi : wrapped;
+}
+
+//! Advance a phase by a number of frames and wrap it into [0, 2pi)
+float advancePhase(const float phase, const float phaseIncrement, const int numFrames)
+{
+  // Use double precision since the unwrapped phase can be large
+  constexpr auto kTwoPiDouble = M_PI * 2.0;
+  const auto advancedPhase = double(phase) + double(phaseIncrement) * numFrames;
+  return float(advancedPhase - kTwoPiDouble * std::floor(advancedPhase / kTwoPiDouble));
+}
+
+//! Generates sines for FloatVector::kSize partials of a block by evaluating sinApprox()
+class PolynomialSineOscillator
+{
+public:
+  PolynomialSineOscillator(const PartialBlock& block, const int offset)
+    : mPhaseIncrement{loadAligned(&block.phaseIncrement[offset])}
+    , mPhase{loadAligned(&block.phase[offset])}
+  {
+  }
+
+  FloatVector next()
+  {
+    // sin(phase) == sin(pi - phase), which moves the argument into (-pi, pi]
+    const auto result = sinApprox(broadcast(float(M_PI)) - mPhase);
+
+    const auto twoPi = broadcast(kTwoPi);
+    mPhase = mPhase + mPhaseIncrement;
+    mPhase = mPhase - valueIfGreaterEqual(mPhase, twoPi, twoPi);
+
+    return result;
+  }
+
+  void storeState(PartialBlock& block, const int offset, int /* numFrames */) const
+  {
+    storeAligned(&block.phase[offset], mPhase);
+  }
+
+private:
+  FloatVector mPhaseIncrement;
+  FloatVector mPhase;
+};
+
+/*! Generates sines for FloatVector::kSize partials of a block with a complex rotation.
+ *
+ * Each sample rotates (cos, sin) by the phase increment, which costs four multiplies and
+ * no transcendental functions. The rotation is seeded from the block's phase on every
+ * call and the phase is advanced analytically at the end, so rounding errors in the
+ * recurrence (which slowly change the amplitude) never accumulate across buffers.
+ */
+class QuadratureOscillator
+{
+public:
+  QuadratureOscillator(const PartialBlock& block, const int offset)
+    : mRotationCos{loadAligned(&block.phaseIncrementCos[offset])}
+    , mRotationSin{loadAligned(&block.phaseIncrementSin[offset])}
+  {
+    // sin(phase) == sin(pi - phase) and cos(phase) == sin(pi/2 - phase), with the
+    // arguments moved into [-pi, pi]
+    const auto pi = broadcast(float(M_PI));
+    const auto phase = loadAligned(&block.phase[offset]);
+    const auto cosArgument = broadcast(float(M_PI_2)) - phase;
+    mSin = sinApprox(pi - phase);
+    mCos = sinApprox(cosArgument
+                     + valueIfGreaterEqual(broadcast(0.0f) - pi, cosArgument,
+                                           broadcast(kTwoPi)));
+  }
+
+  FloatVector next()
+  {
+    const auto result = mSin;
+    const auto cos = mCos * mRotationCos - mSin * mRotationSin;
+    mSin = mSin * mRotationCos + mCos * mRotationSin;
+    mCos = cos;
+    return result;
+  }
+
+  void storeState(PartialBlock& block, const int offset, const int numFrames) const
+  {
+    for (int i = 0; i < FloatVector::kSize; ++i)
+    {
+      auto& phase = block.phase[offset + i];
+      phase = advancePhase(phase, block.phaseIncrement[offset + i], numFrames);
+    }
+  }
+
+private:
+  FloatVector mRotationCos;
+  FloatVector mRotationSin;
+  FloatVector mCos;
+  FloatVector mSin;
+};
+
+template <typename Oscillator, size_t... kVectorIndices>
+std::array<Oscillator, sizeof...(kVectorIndices)> makeOscillators(
+  const PartialBlock& block, std::index_sequence<kVectorIndices...>)
+{
+  return {Oscillator{block, int(kVectorIndices) * FloatVector::kSize}...};
+}
+
+template <typename Oscillator>
+void processPartialBlockVectorized(PartialBlock& block,
+                                   const int numFrames,
+                                   const StereoAudioBufferPtrs output)
+{
+  if (isSilent(block))
+  {
+    return;
+  }
+
+  constexpr auto kNumVectors = kPartialBlockSize / FloatVector::kSize;
+  const auto one = broadcast(1.0f);
+  const auto zero = broadcast(0.0f);
+
+  std::array<FloatVector, kNumVectors> targetAmp;
+  std::array<FloatVector, kNumVectors> ampSmoothingCoeff;
+  std::array<FloatVector, kNumVectors> leftGain;
+  std::array<FloatVector, kNumVectors> rightGain;
+  std::array<FloatVector, kNumVectors> amp;
+  for (int vectorIndex = 0; vectorIndex < kNumVectors; ++vectorIndex)
+  {
+    const auto offset = vectorIndex * FloatVector::kSize;
+    targetAmp[vectorIndex] = loadAligned(&block.targetAmp[offset]);
+    ampSmoothingCoeff[vectorIndex] = loadAligned(&block.ampSmoothingCoeff[offset]);
+    leftGain[vectorIndex] = loadAligned(&block.leftGain[offset]);
+    rightGain[vectorIndex] = loadAligned(&block.rightGain[offset]);
+    amp[vectorIndex] = loadAligned(&block.amp[offset]);
+  }
+  auto oscillators =
+    makeOscillators<Oscillator>(block, std::make_index_sequence<kNumVectors>{});
+
+  for (int frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+  {
+    // Accumulate all partials of the block per lane so that each frame needs only one
+    // horizontal sum per channel
+    auto left = zero;
+    auto right = zero;
+    for (int vectorIndex = 0; vectorIndex < kNumVectors; ++vectorIndex)
+    {
+      const auto sample = oscillators[vectorIndex].next() * amp[vectorIndex];
+      left = left + sample * leftGain[vectorIndex];
+      right = right + sample * rightGain[vectorIndex];
+
+      amp[vectorIndex] = (one - ampSmoothingCoeff[vectorIndex]) * amp[vectorIndex]
+                         + ampSmoothingCoeff[vectorIndex] * targetAmp[vectorIndex];
+    }
+    output[0][frameIndex] += horizontalSum(left);
+    output[1][frameIndex] += horizontalSum(right);
+  }
+
+  for (int vectorIndex = 0; vectorIndex < kNumVectors; ++vectorIndex)
+  {
+    const auto offset = vectorIndex * FloatVector::kSize;
+    storeAligned(&block.amp[offset], amp[vectorIndex]);
+    oscillators[vectorIndex].storeState(block, offset, numFrames);
+  }
+}
+
+} // namespace
+
+HarmonicStack generateSaw(const float sampleRate,
+                          const float amp,
+                          const std::chrono::duration<float> ampSmoothingDuration,
+                          const float pan,
+                          const float frequency)
+{
+  HarmonicStack result;
 
-  const auto ampSmoothingCoeff = makeOnePole(ampSmoothingDuration.count(), sampleRate);
   const auto nyquistFrequency = sampleRate / 2.0f;
   const auto numHarmonics = int(nyquistFrequency / frequency);
   for (int i = 1; i <= numHarmonics; ++i)
   {
-    Partial partial;
-    partial.ampWhenActive =
-      (2.0f * amp / float(M_PI)) * (1.0f / i) * (i % 2 == 0 ? 1.0f : -1.0f);
-    partial.ampSmoothingCoeff = ampSmoothingCoeff;
-    partial.pan = pan;
-    const auto partialFrequency = i * frequency;
-    const auto samplesPerCycle = sampleRate / partialFrequency;
-    partial.phaseIncrement = kTwoPi / samplesPerCycle;
-
-    result.emplace_back(partial);
+    result.ampWhenActive.push_back((2.0f * amp / float(M_PI)) * (1.0f / i)
+                                   * (i % 2 == 0 ? 1.0f : -1.0f));
   }
+  result.targetAmp.resize(result.ampWhenActive.size(), 0.0f);
+  result.amp.resize(result.ampWhenActive.size(), 0.0f);
+  result.ampSmoothingCoeff = makeOnePole(ampSmoothingDuration.count(), sampleRate);
+  result.pan = pan;
+  const auto samplesPerCycle = sampleRate / frequency;
+  result.phaseIncrement = kTwoPi / samplesPerCycle;
 
   return result;
 }
 
-std::vector<Partial> generateChord(
+std::vector<HarmonicStack> generateChord(
   const float sampleRate,
   const std::chrono::duration<float> ampSmoothingDuration,
   const std::vector<float>& noteNumbers)
 {
-  std::vector<Partial> result;
+  std::vector<HarmonicStack> result;
 
   for (const auto noteNumber : noteNumbers)
   {
     const auto frequency = noteToFrequency(noteNumber);
 
-    const auto appendPartials = [&](const auto amp, const auto pan, const auto detune) {
-      const auto partials =
-        generateSaw(sampleRate, amp, ampSmoothingDuration, pan, frequency + detune);
-      std::copy(partials.begin(), partials.end(), std::back_insert_iterator(result));
+    const auto appendSaw = [&](const auto amp, const auto pan, const auto detune) {
+      result.push_back(
+        generateSaw(sampleRate, amp, ampSmoothingDuration, pan, frequency + detune));
     };
 
     const auto amp = 1.0f / (noteNumbers.size() * 5);
-    appendPartials(amp, -1.0f, -4.0f);
-    appendPartials(amp, -1.0f, -2.0f);
-    appendPartials(amp, 0.0f, 0.0f);
-    appendPartials(amp, 1.0f, 2.0f);
-    appendPartials(amp, 1.0f, 4.0f);
+    appendSaw(amp, -1.0f, -4.0f);
+    appendSaw(amp, -1.0f, -2.0f);
+    appendSaw(amp, 0.0f, 0.0f);
+    appendSaw(amp, 1.0f, 2.0f);
+    appendSaw(amp, 1.0f, 4.0f);
+  }
+
+  return result;
+}
+
+std::vector<Partial> toPartials(const std::vector<HarmonicStack>& stacks)
+{
+  std::vector<Partial> result;
+
+  for (const auto& stack : stacks)
+  {
+    for (size_t i = 0; i < stack.ampWhenActive.size(); ++i)
+    {
+      Partial partial;
+      partial.ampWhenActive = stack.ampWhenActive[i];
+      partial.targetAmp = stack.targetAmp[i];
+      partial.amp = stack.amp[i];
+      partial.ampSmoothingCoeff = stack.ampSmoothingCoeff;
+      partial.pan = stack.pan;
+      partial.phaseIncrement = stack.phaseIncrement * float(i + 1);
+      partial.phase = wrapPhase(stack.phase * float(i + 1));
+
+      result.emplace_back(partial);
+    }
   }
 
   std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
@@ -103,26 +300,192 @@ std::vector<Partial> randomizePhases(std::vector<Partial> partials,
   return partials;
 }
 
-void processPartial(Partial& partial, const int numFrames, StereoAudioBuffer& output)
+std::vector<HarmonicStack> randomizePhases(std::vector<HarmonicStack> stacks,
+                                           const int stacksToSkip)
 {
-  const auto kSilenceThreshold = 0.00001f;
-  if (std::fabs(partial.targetAmp) > kSilenceThreshold
-      || std::fabs(partial.amp) > kSilenceThreshold)
+  std::default_random_engine generator{42};
+  std::normal_distribution<float> phaseDistribution(0.0, kTwoPi);
+  const auto iFirst = std::min(stacks.begin() + stacksToSkip, stacks.end());
+  std::for_each(iFirst, stacks.end(), [&](HarmonicStack& stack) {
+    stack.phase = wrapPhase(phaseDistribution(generator));
+  });
+  return stacks;
+}
+
+std::vector<PartialBlock> makePartialBlocks(const std::vector<Partial>& partials)
+{
+  const auto numBlocks = (partials.size() + kPartialBlockSize - 1) / kPartialBlockSize;
+  std::vector<PartialBlock> result(numBlocks);
+  for (size_t partialIndex = 0; partialIndex < partials.size(); ++partialIndex)
+  {
+    const auto& partial = partials[partialIndex];
+    auto& block = result[partialIndex / kPartialBlockSize];
+    const auto lane = partialIndex % kPartialBlockSize;
+
+    block.ampWhenActive[lane] = partial.ampWhenActive;
+    block.targetAmp[lane] = partial.targetAmp;
+    block.amp[lane] = partial.amp;
+    block.ampSmoothingCoeff[lane] = partial.ampSmoothingCoeff;
+    std::tie(block.leftGain[lane], block.rightGain[lane]) =
+      equalPowerPanGains(partial.pan);
+    block.phaseIncrement[lane] = partial.phaseIncrement;
+    block.phase[lane] = wrapPhase(partial.phase);
+    block.phaseIncrementCos[lane] = std::cos(partial.phaseIncrement);
+    block.phaseIncrementSin[lane] = std::sin(partial.phaseIncrement);
+  }
+
+  return result;
+}
+
+bool isSilent(const PartialBlock& block)
+{
+  return std::none_of(block.targetAmp.begin(), block.targetAmp.end(), isAudible)
+         && std::none_of(block.amp.begin(), block.amp.end(), isAudible);
+}
+
+bool isMuted(const PartialBlock& block)
+{
+  return std::none_of(block.amp.begin(), block.amp.end(), isAudible);
+}
+
+void processPartialBlockReference(PartialBlock& block,
+                                  const int numFrames,
+                                  const StereoAudioBufferPtrs output)
+{
+  for (int lane = 0; lane < kPartialBlockSize; ++lane)
   {
-    const auto channelAmps = equalPowerPanGains(partial.pan);
-    for (int frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+    if (isAudible(block.targetAmp[lane]) || isAudible(block.amp[lane]))
     {
-      const auto sample = std::sin(partial.phase) * partial.amp;
-      output[0][frameIndex] += sample * channelAmps.first;
-      output[1][frameIndex] += sample * channelAmps.second;
+      for (int frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+      {
+        const auto sample = std::sin(block.phase[lane]) * block.amp[lane];
+        output[0][frameIndex] += sample * block.leftGain[lane];
+        output[1][frameIndex] += sample * block.rightGain[lane];
 
-      partial.amp = lerp(partial.amp, partial.targetAmp, partial.ampSmoothingCoeff);
+        block.amp[lane] =
+          lerp(block.amp[lane], block.targetAmp[lane], block.ampSmoothingCoeff[lane]);
 
-      partial.phase += partial.phaseIncrement;
-      if (partial.phase >= kTwoPi)
+        block.phase[lane] += block.phaseIncrement[lane];
+        if (block.phase[lane] >= kTwoPi)
+        {
+          block.phase[lane] -= kTwoPi;
+        }
+      }
+    }
+  }
+}
+
+void processPartialBlock(PartialBlock& block,
+                         const int numFrames,
+                         const StereoAudioBufferPtrs output)
+{
+  processPartialBlockVectorized<PolynomialSineOscillator>(block, numFrames, output);
+}
+
+void processPartialBlockQuadrature(PartialBlock& block,
+                                   const int numFrames,
+                                   const StereoAudioBufferPtrs output)
+{
+  processPartialBlockVectorized<QuadratureOscillator>(block, numFrames, output);
+}
+
+bool isSilent(const HarmonicStack& stack)
+{
+  return std::none_of(stack.targetAmp.begin(), stack.targetAmp.end(), isAudible)
+         && std::none_of(stack.amp.begin(), stack.amp.end(), isAudible);
+}
+
+void processHarmonicStack(HarmonicStack& stack,
+                          const int numFrames,
+                          const StereoAudioBufferPtrs output)
+{
+  // Only run the recurrence up to the highest harmonic that can be heard
+  int numHarmonics = int(stack.amp.size());
+  while (numHarmonics > 0 && !isAudible(stack.targetAmp[numHarmonics - 1])
+         && !isAudible(stack.amp[numHarmonics - 1]))
+  {
+    --numHarmonics;
+  }
+  if (numHarmonics == 0)
+  {
+    return;
+  }
+
+  // Each lane renders one of FloatVector::kSize consecutive frames. The lanes start at
+  // successive phases of the fundamental and are rotated by kSize increments per step.
+  constexpr auto kNumLanes = FloatVector::kSize;
+  alignas(kSimdAlignment) std::array<float, kNumLanes> laneCosines{};
+  alignas(kSimdAlignment) std::array<float, kNumLanes> laneSines{};
+  alignas(kSimdAlignment) std::array<float, kNumLanes> laneAmpDecays{};
+  const auto ampDecay = 1.0f - stack.ampSmoothingCoeff;
+  for (int lane = 0; lane < kNumLanes; ++lane)
+  {
+    const auto lanePhase = stack.phase + float(lane) * stack.phaseIncrement;
+    laneCosines[lane] = std::cos(lanePhase);
+    laneSines[lane] = std::sin(lanePhase);
+    laneAmpDecays[lane] = std::pow(ampDecay, float(lane));
+  }
+  auto fundamentalCos = loadAligned(laneCosines.data());
+  auto fundamentalSin = loadAligned(laneSines.data());
+  const auto rotationCos = broadcast(std::cos(float(kNumLanes) * stack.phaseIncrement));
+  const auto rotationSin = broadcast(std::sin(float(kNumLanes) * stack.phaseIncrement));
+
+  // Amps approach their targets geometrically: amp[n] - target == (amp[0] - target) *
+  // ampDecay^n. This gives each lane's amp without a sequential dependency on the others.
+  const auto laneAmpDecay = loadAligned(laneAmpDecays.data());
+  const auto stepAmpDecay = std::pow(ampDecay, float(kNumLanes));
+
+  const auto [leftGain, rightGain] = equalPowerPanGains(stack.pan);
+  const auto two = broadcast(2.0f);
+
+  for (int frameIndex = 0; frameIndex < numFrames; frameIndex += kNumLanes)
+  {
+    const auto numFramesInStep = std::min(kNumLanes, numFrames - frameIndex);
+    const auto ampDecayInStep = numFramesInStep == kNumLanes
+                                  ? stepAmpDecay
+                                  : std::pow(ampDecay, float(numFramesInStep));
+
+    // sin(k x) for all harmonics via sin((k + 1) x) = 2 cos(x) sin(k x) - sin((k - 1) x)
+    const auto twoCos = two * fundamentalCos;
+    auto previousSin = broadcast(0.0f);
+    auto currentSin = fundamentalSin;
+    auto sum = broadcast(0.0f);
+    for (int harmonicIndex = 0; harmonicIndex < numHarmonics; ++harmonicIndex)
+    {
+      auto& amp = stack.amp[harmonicIndex];
+      const auto targetAmp = stack.targetAmp[harmonicIndex];
+      const auto laneAmps =
+        broadcast(targetAmp) + broadcast(amp - targetAmp) * laneAmpDecay;
+      amp = targetAmp + (amp - targetAmp) * ampDecayInStep;
+
+      sum = sum + laneAmps * currentSin;
+      const auto nextSin = twoCos * currentSin - previousSin;
+      previousSin = currentSin;
+      currentSin = nextSin;
+    }
+
+    const auto cos = fundamentalCos * rotationCos - fundamentalSin * rotationSin;
+    fundamentalSin = fundamentalSin * rotationCos + fundamentalCos * rotationSin;
+    fundamentalCos = cos;
+
+    if (numFramesInStep == kNumLanes)
+    {
+      float* pLeft = &output[0][frameIndex];
+      float* pRight = &output[1][frameIndex];
+      store(pLeft, load(pLeft) + sum * broadcast(leftGain));
+      store(pRight, load(pRight) + sum * broadcast(rightGain));
+    }
+    else
+    {
+      alignas(kSimdAlignment) std::array<float, kNumLanes> samples{};
+      storeAligned(samples.data(), sum);
+      for (int lane = 0; lane < numFramesInStep; ++lane)
       {
-        partial.phase -= kTwoPi;
+        output[0][frameIndex + lane] += samples[lane] * leftGain;
+        output[1][frameIndex + lane] += samples[lane] * rightGain;
       }
     }
   }
+
+  stack.phase = advancePhase(stack.phase, stack.phaseIncrement, numFrames);
 }
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "AudioBuffer.hpp"
+#include "Base/Simd.hpp"
 
 #include <array>
 #include <chrono>
@@ -41,16 +42,110 @@ struct Partial
   float phase{};
 };
 
-std::vector<Partial> generateSaw(float sampleRate,
-                                 float amp,
-                                 std::chrono::duration<float> ampSmoothingDuration,
-                                 float pan,
-                                 float frequency);
+/*! The harmonics of a sawtooth wave, rendered together.
+ *
+ * All harmonics share the fundamental's phase, pan and smoothing coefficient, so sin(k x)
+ * for every harmonic k can be derived from sin(x) and cos(x) with a Chebyshev recurrence
+ * instead of running an oscillator per harmonic. Each harmonic keeps its own amplitude.
+ * Element 0 of the amplitude vectors belongs to the fundamental.
+ */
+struct HarmonicStack
+{
+  std::vector<float> ampWhenActive;
+  std::vector<float> targetAmp;
+  std::vector<float> amp;
+  float ampSmoothingCoeff{};
 
-std::vector<Partial> generateChord(float sampleRate,
-                                   std::chrono::duration<float> ampSmoothingDuration,
-                                   const std::vector<float>& noteNumbers);
+  float pan{};
+
+  //! The phase increment and phase of the fundamental
+  float phaseIncrement{};
+  float phase{};
+};
+
+HarmonicStack generateSaw(float sampleRate,
+                          float amp,
+                          std::chrono::duration<float> ampSmoothingDuration,
+                          float pan,
+                          float frequency);
+
+std::vector<HarmonicStack> generateChord(
+  float sampleRate,
+  std::chrono::duration<float> ampSmoothingDuration,
+  const std::vector<float>& noteNumbers);
+
+//! Flatten harmonic stacks into individual partials sorted by frequency
+std::vector<Partial> toPartials(const std::vector<HarmonicStack>& stacks);
 
 std::vector<Partial> randomizePhases(std::vector<Partial> partials, int partialsToSkip);
 
-void processPartial(Partial& partial, int numFrames, StereoAudioBuffer& output);
+/*! Randomize the phase of each stack's fundamental. Harmonics follow the fundamental.
+ *
+ * generateChord() returns stacks sorted by frequency if the note numbers are sorted, so
+ * skipping the first stacks then roughly matches skipping the lowest partials.
+ */
+std::vector<HarmonicStack> randomizePhases(std::vector<HarmonicStack> stacks,
+                                           int stacksToSkip);
+
+constexpr auto kPartialBlockSize = 8;
+
+/*! A fixed-size group of partials stored as a structure of arrays.
+ *
+ * Each field holds one value per partial so that kernels can process several partials
+ * per SIMD register. Pan positions are stored as precomputed channel gains. Lanes beyond
+ * the last partial of a bank are silent padding.
+ */
+struct alignas(kSimdAlignment) PartialBlock
+{
+  using Lanes = std::array<float, kPartialBlockSize>;
+
+  Lanes ampWhenActive{};
+  Lanes targetAmp{};
+  Lanes amp{};
+  Lanes ampSmoothingCoeff{};
+
+  Lanes leftGain{};
+  Lanes rightGain{};
+
+  Lanes phaseIncrement{};
+  Lanes phase{};
+
+  //! The cosine and sine of phaseIncrement, used by the quadrature oscillator
+  Lanes phaseIncrementCos{};
+  Lanes phaseIncrementSin{};
+};
+
+static_assert(kPartialBlockSize % FloatVector::kSize == 0,
+              "A partial block must hold a whole number of vectors");
+static_assert(sizeof(PartialBlock::Lanes) % kSimdAlignment == 0,
+              "Partial block fields must stay aligned");
+
+std::vector<PartialBlock> makePartialBlocks(const std::vector<Partial>& partials);
+
+//! True if no partial of the block is audible now or fading towards an audible amplitude
+bool isSilent(const PartialBlock& block);
+
+//! True if no partial of the block is audible now, even if some are fading in
+bool isMuted(const PartialBlock& block);
+
+//! Render a block using std::sin() for each partial and sample
+void processPartialBlockReference(PartialBlock& block,
+                                  int numFrames,
+                                  StereoAudioBufferPtrs output);
+
+//! Render a block with SIMD instructions, processing FloatVector::kSize partials at once
+void processPartialBlock(PartialBlock& block,
+                         int numFrames,
+                         StereoAudioBufferPtrs output);
+
+//! Render a block with SIMD instructions, generating sines with a recursive oscillator
+void processPartialBlockQuadrature(PartialBlock& block,
+                                   int numFrames,
+                                   StereoAudioBufferPtrs output);
+
+//! True if no harmonic of the stack is audible now or fading towards an audible amplitude
+bool isSilent(const HarmonicStack& stack);
+
+void processHarmonicStack(HarmonicStack& stack,
+                          int numFrames,
+                          StereoAudioBufferPtrs output);
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "QualityGovernor.hpp"
+
+#include "Constants.hpp"
+
+#include "Base/Assert.hpp"
+#include "Base/Math.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+//! The time constant of the load smoothing
+constexpr auto kLoadSmoothingDuration = std::chrono::milliseconds{100};
+
+//! The limit is lowered when the smoothed load exceeds this
+constexpr auto kHighLoad = 0.7;
+
+//! The load that lowering the limit aims for
+constexpr auto kTargetLoad = 0.6;
+
+//! The limit is only raised while the smoothed load stays below this
+constexpr auto kLowLoad = 0.45;
+
+/*! The minimum time between lowering the limit twice.
+ *
+ * Shed partials keep being rendered while they fade out, so the load only drops after
+ * the amp smoothing has finished.
+ */
+constexpr auto kDecreaseInterval = 2 * kAmpSmoothingDuration;
+
+//! How long the load must stay low before raising the limit by one step
+constexpr auto kLightLoadDurationBeforeIncrease = std::chrono::seconds{2};
+
+//! The fraction of the limit restored per step, and the minimum number of partials
+constexpr auto kIncreaseFactor = 0.1;
+constexpr auto kMinNumPartialsPerIncrease = kNumPartialsPerProcessingChunk;
+
+} // namespace
+
+void QualityGovernor::reset()
+{
+  mLoad = 0.0;
+  mMaxNumActivePartials = std::nullopt;
+  mTimeSinceDecrease = Seconds{};
+  mLightLoadDuration = Seconds{};
+}
+
+std::optional<int> QualityGovernor::maxNumActivePartials() const
+{
+  return mMaxNumActivePartials;
+}
+
+void QualityGovernor::update(const Seconds renderDuration,
+                             const Seconds bufferDuration,
+                             const int numActivePartials)
+{
+  assertRelease(bufferDuration > Seconds{}, "Invalid buffer duration");
+  assertRelease(numActivePartials >= 0, "Invalid number of partials");
+
+  const auto smoothingCoeff = 1.0 - std::exp(-bufferDuration / kLoadSmoothingDuration);
+  mLoad = lerp(mLoad, renderDuration / bufferDuration, smoothingCoeff);
+  mTimeSinceDecrease += bufferDuration;
+
+  // The limit no longer matters once fewer partials are requested
+  if (mMaxNumActivePartials && numActivePartials < *mMaxNumActivePartials)
+  {
+    mMaxNumActivePartials = std::nullopt;
+  }
+
+  if (mLoad > kHighLoad)
+  {
+    mLightLoadDuration = Seconds{};
+    if (mTimeSinceDecrease >= kDecreaseInterval && numActivePartials > 0)
+    {
+      mMaxNumActivePartials = int(numActivePartials * (kTargetLoad / mLoad));
+      mTimeSinceDecrease = Seconds{};
+    }
+  }
+  else if (mLoad < kLowLoad && mMaxNumActivePartials)
+  {
+    mLightLoadDuration += bufferDuration;
+    if (mLightLoadDuration >= kLightLoadDurationBeforeIncrease)
+    {
+      const auto numRestoredPartials = std::max(
+        int(*mMaxNumActivePartials * kIncreaseFactor), kMinNumPartialsPerIncrease);
+      *mMaxNumActivePartials += numRestoredPartials;
+      mLightLoadDuration = Seconds{};
+    }
+  }
+  else
+  {
+    mLightLoadDuration = Seconds{};
+  }
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+
+/*! Limits the number of active partials so that rendering keeps up on weak devices.
+ *
+ * The load of a buffer is the time spent rendering it divided by its duration. The
+ * governor smooths the load over recent buffers. If the smoothed load exceeds a high
+ * threshold, the limit is lowered in proportion so that the load returns to a target.
+ * Once the load has stayed below a low threshold for a while, the limit is raised step
+ * by step. The gap between the thresholds and the wait before raising the limit keep it
+ * from oscillating.
+ *
+ * Partials are activated in order of frequency, so lowering the limit drops the highest
+ * harmonics first, which are the quietest. They fade out with the amp smoothing of the
+ * partials, so shedding them doesn't click.
+ *
+ * Must only be used from the audio I/O thread.
+ */
+class QualityGovernor
+{
+public:
+  using Seconds = std::chrono::duration<double>;
+
+  //! Start over without a limit
+  void reset();
+
+  //! The maximum number of active partials for the next buffer, if limited
+  std::optional<int> maxNumActivePartials() const;
+
+  /*! Update the limit after rendering a buffer.
+   *
+   * numActivePartials is the number of partials that were active in the buffer, after
+   * applying the limit.
+   */
+  void update(Seconds renderDuration, Seconds bufferDuration, int numActivePartials);
+
+private:
+  double mLoad{0.0};
+  std::optional<int> mMaxNumActivePartials;
+  Seconds mTimeSinceDecrease{};
+  Seconds mLightLoadDuration{};
+};
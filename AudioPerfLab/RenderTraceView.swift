@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+import UIKit
+
+// A timeline of a RenderTraceMeasurement with one row per processing thread. Each row
+// shows the time from the thread's wakeup until it started processing (faded) and its
+// processing time. The gray line marks the end of rendering and the red line marks the
+// buffer duration, i.e. the deadline.
+class RenderTraceView: UIView {
+  var trace: RenderTraceMeasurement? {
+    didSet {
+      setNeedsDisplay()
+    }
+  }
+  var bufferDuration = 0.0 {
+    didSet {
+      setNeedsDisplay()
+    }
+  }
+
+  private static let rowPadding: CGFloat = 1.0
+  private static let waitAlpha: CGFloat = 0.3
+
+  private static func times(_ tuple: Any) -> [Double] {
+    return Mirror(reflecting: tuple).children.map { $0.value as! Double }
+  }
+
+  override func draw(_ rect: CGRect) {
+    guard let trace = trace, trace.numProcessingThreads > 0, bufferDuration > 0.0 else {
+      return
+    }
+
+    let wakeTimes = RenderTraceView.times(trace.threadWakeTimes)
+    let processStartTimes = RenderTraceView.times(trace.threadProcessStartTimes)
+    let processEndTimes = RenderTraceView.times(trace.threadProcessEndTimes)
+
+    // Show the whole buffer duration, or more if the render missed the deadline
+    let duration = max(bufferDuration, trace.renderEndedEnd, trace.callbackEnd)
+    let timeToX = { (time: Double) in CGFloat(time / duration) * self.bounds.width }
+    let rowHeight = bounds.height / CGFloat(trace.numProcessingThreads)
+
+    for threadIndex in 0..<Int(trace.numProcessingThreads) {
+      let y = CGFloat(threadIndex) * rowHeight + RenderTraceView.rowPadding
+      let height = rowHeight - 2.0 * RenderTraceView.rowPadding
+      let color = ViewController.colorForThread(threadIndex)
+      let processStart = processStartTimes[threadIndex]
+      let processEnd = processEndTimes[threadIndex]
+
+      let wakeTime = wakeTimes[threadIndex]
+      if wakeTime >= 0.0 && processStart >= wakeTime {
+        color.withAlphaComponent(RenderTraceView.waitAlpha).setFill()
+        UIRectFill(CGRect(
+          x: timeToX(wakeTime), y: y,
+          width: timeToX(processStart - wakeTime), height: height))
+      }
+
+      if processStart >= 0.0 && processEnd >= processStart {
+        color.setFill()
+        UIRectFill(CGRect(
+          x: timeToX(processStart), y: y,
+          width: max(1.0, timeToX(processEnd - processStart)), height: height))
+      }
+    }
+
+    if trace.renderEndedEnd >= 0.0 {
+      UIColor.gray.setFill()
+      UIRectFill(CGRect(
+        x: timeToX(trace.renderEndedEnd), y: 0.0, width: 1.0, height: bounds.height))
+    }
+    ViewController.dropoutColor.setFill()
+    UIRectFill(CGRect(
+      x: min(timeToX(bufferDuration), bounds.width - 1.0), y: 0.0,
+      width: 1.0, height: bounds.height))
+  }
+}
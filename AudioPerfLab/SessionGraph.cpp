@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SessionGraph.hpp"
+
+#include "Base/Assert.hpp"
+#include "Constants.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+StereoAudioBuffer makeBuffer()
+{
+  return {
+    std::vector<float>(kMaxNumFrames, 0.0f), std::vector<float>(kMaxNumFrames, 0.0f)};
+}
+
+void clear(StereoAudioBuffer& buffer, const int numFrames)
+{
+  std::fill_n(buffer[0].begin(), numFrames, 0.0f);
+  std::fill_n(buffer[1].begin(), numFrames, 0.0f);
+}
+
+void add(const StereoAudioBuffer& source, StereoAudioBuffer& dest, const int numFrames)
+{
+  for (int channel = 0; channel < 2; ++channel)
+  {
+    std::transform(source[channel].begin(), source[channel].begin() + numFrames,
+                   dest[channel].begin(), dest[channel].begin(),
+                   [](const float x, const float y) { return x + y; });
+  }
+}
+
+} // namespace
+
+void SessionGraph::setup(const std::vector<Partial>& partials,
+                         const int numTracks,
+                         const int numBuses)
+{
+  assertRelease(numTracks > 0 && numBuses > 0, "Invalid session layout");
+
+  auto activePartials = partials;
+  for (auto& partial : activePartials)
+  {
+    partial.targetAmp = partial.ampWhenActive;
+  }
+  const auto blocks = makePartialBlocks(activePartials);
+
+  // Give each track a contiguous range of blocks so that tracks have similar costs
+  mTracks.clear();
+  for (int trackIndex = 0; trackIndex < numTracks; ++trackIndex)
+  {
+    const auto blocksBegin = blocks.begin() + blocks.size() * trackIndex / numTracks;
+    const auto blocksEnd = blocks.begin() + blocks.size() * (trackIndex + 1) / numTracks;
+    mTracks.push_back({std::vector<PartialBlock>(blocksBegin, blocksEnd), makeBuffer()});
+  }
+  mBuses.clear();
+  for (int busIndex = 0; busIndex < numBuses; ++busIndex)
+  {
+    mBuses.push_back({{}, makeBuffer()});
+  }
+  mMasterBuffer = makeBuffer();
+
+  mGraph.clear();
+  std::vector<TaskGraph::TaskId> busTasks;
+  for (auto& bus : mBuses)
+  {
+    busTasks.push_back(mGraph.addTask([this, &bus](int) { processBus(bus); }));
+  }
+  const auto masterTask = mGraph.addTask([this](int) { processMaster(); });
+  for (const auto busTask : busTasks)
+  {
+    mGraph.addDependency(busTask, masterTask);
+  }
+  for (int trackIndex = 0; trackIndex < numTracks; ++trackIndex)
+  {
+    auto& track = mTracks[trackIndex];
+    const auto trackTask = mGraph.addTask([this, &track](int) { processTrack(track); });
+    const auto busIndex = trackIndex % numBuses;
+    mBuses[busIndex].trackIndices.push_back(trackIndex);
+    mGraph.addDependency(trackTask, busTasks[busIndex]);
+  }
+  mGraph.compile();
+}
+
+void SessionGraph::prepare(const int numFrames)
+{
+  assertRelease(numFrames > 0 && numFrames <= kMaxNumFrames, "Invalid number of frames");
+
+  mNumFrames = numFrames;
+  mGraph.prepare();
+}
+
+void SessionGraph::process(const int threadIndex) { mGraph.process(threadIndex); }
+
+void SessionGraph::mixTo(const StereoAudioBufferPtrs dest, const int numFrames)
+{
+  assertRelease(numFrames > 0 && numFrames <= kMaxNumFrames, "Invalid number of frames");
+
+  mFader.process({mMasterBuffer[0].data(), mMasterBuffer[1].data()}, uint64_t(numFrames));
+  for (int channel = 0; channel < 2; ++channel)
+  {
+    std::transform(mMasterBuffer[channel].begin(),
+                   mMasterBuffer[channel].begin() + numFrames, dest[channel],
+                   dest[channel], [](const float x, const float y) { return x + y; });
+  }
+}
+
+void SessionGraph::fadeTo(const float amp, const int numFrames)
+{
+  mFader.fadeTo(amp, uint64_t(numFrames));
+}
+
+bool SessionGraph::isFading() const { return mFader.isFading(); }
+
+void SessionGraph::processTrack(Track& track)
+{
+  clear(track.buffer, mNumFrames);
+  const StereoAudioBufferPtrs output{track.buffer[0].data(), track.buffer[1].data()};
+  for (auto& block : track.blocks)
+  {
+    processPartialBlock(block, mNumFrames, output);
+  }
+}
+
+void SessionGraph::processBus(Bus& bus)
+{
+  clear(bus.buffer, mNumFrames);
+  for (const auto trackIndex : bus.trackIndices)
+  {
+    add(mTracks[trackIndex].buffer, bus.buffer, mNumFrames);
+  }
+}
+
+void SessionGraph::processMaster()
+{
+  clear(mMasterBuffer, mNumFrames);
+  for (const auto& bus : mBuses)
+  {
+    add(bus.buffer, mMasterBuffer, mNumFrames);
+  }
+}
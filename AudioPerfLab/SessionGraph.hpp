@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "AudioBuffer.hpp"
+#include "Base/TaskGraph.hpp"
+#include "Base/VolumeFader.hpp"
+#include "Partial.hpp"
+
+#include <vector>
+
+/*! Renders partials like a mixing session in which tracks feed buses that feed a master.
+ *
+ * Each track renders its share of the partials, each bus sums its tracks and the master
+ * sums the buses. Unlike ParallelSineBank the work has serial dependencies, so it's
+ * executed as a TaskGraph by all processing threads.
+ */
+class SessionGraph
+{
+public:
+  /*! Split the partials into numTracks tracks, assigned to numBuses buses in turn.
+   *
+   * All partials are active. Must not be called while rendering.
+   */
+  void setup(const std::vector<Partial>& partials, int numTracks, int numBuses);
+
+  //! Prepare rendering of the next buffer
+  void prepare(int numFrames);
+
+  //! Render tasks of the graph until all of them have finished
+  void process(int threadIndex);
+
+  //! Add the master output rendered by process(), scaled by the fade gain, to dest
+  void mixTo(StereoAudioBufferPtrs dest, int numFrames);
+
+  /*! Ramp the gain applied by mixTo() to amp over numFrames frames.
+   *
+   * The gain starts at zero, so the graph is faded in once it's turned on.
+   */
+  void fadeTo(float amp, int numFrames);
+
+  //! True while the gain is ramping
+  bool isFading() const;
+
+private:
+  struct Track
+  {
+    std::vector<PartialBlock> blocks;
+    StereoAudioBuffer buffer;
+  };
+
+  struct Bus
+  {
+    std::vector<int> trackIndices;
+    StereoAudioBuffer buffer;
+  };
+
+  void processTrack(Track& track);
+  void processBus(Bus& bus);
+  void processMaster();
+
+  std::vector<Track> mTracks;
+  std::vector<Bus> mBuses;
+  StereoAudioBuffer mMasterBuffer;
+  TaskGraph mGraph;
+  VolumeFader<float> mFader{0.0f};
+  int mNumFrames{0};
+};
@@ -29,6 +29,9 @@ class ViewController: UITableViewController {
   private var coreActivityViews: [ActivityView] = []
   private var tableViewHeaders: [CollapsibleTableViewHeader] = []
   private var lastNumFrames: Int32?
+  private var slowestRenderTrace: RenderTraceMeasurement?
+  private var slowestRenderDuration = 0.0
+  private var lastRenderTraceWindowTime: Double?
   private var waitingToChangeInput = false
   private var inputMeterSmoother = MeterSmoother()
 
@@ -45,6 +48,7 @@ class ViewController: UITableViewController {
   @IBOutlet weak private var workDistributionOneThreadWarning: UILabel!
   @IBOutlet weak private var coreActivityStackView: UIStackView!
   @IBOutlet weak private var energyUsageView: ActivityView!
+  @IBOutlet weak private var renderTraceView: RenderTraceView!
 
   @IBOutlet weak private var inputMeterView: MeterView!
   @IBOutlet weak private var isAudioInputEnabledSwitch: UISwitch!
@@ -61,16 +65,32 @@ class ViewController: UITableViewController {
   @IBOutlet weak private var minimumLoadSlider: SliderWithValue!
   @IBOutlet weak private var processInDriverThreadControl: UISegmentedControl!
   @IBOutlet weak private var isWorkIntervalOnSwitch: UISwitch!
+  @IBOutlet weak private var workerDispatchControl: UISegmentedControl!
+  @IBOutlet weak private var isWorkerGovernorOnSwitch: UISwitch!
+  @IBOutlet weak private var isDemandWakeupOnSwitch: UISwitch!
+  @IBOutlet weak private var isPipelinedSwitch: UISwitch!
+
+  @IBOutlet weak private var sineKernelControl: UISegmentedControl!
+  @IBOutlet weak private var chunkSchedulingSlider: SliderWithValue!
+  @IBOutlet weak private var isSessionGraphOnSwitch: UISwitch!
+  @IBOutlet weak private var isPartialSheddingOnSwitch: UISwitch!
+  @IBOutlet weak private var isQualityGovernorOnSwitch: UISwitch!
 
   private static let defaultNumBurstSinesPercent = 0.75
+  private static let offlineRenderDuration = 10.0
+
+  // Indexed by ChunkScheduling
+  private static let chunkSchedulingNames = [
+    "Shared", "Stealing", "Affinity", "Balanced", "Guided", "Cost"]
 
   private static let maxEnergyViewPowerInWatts = 5.0
   private static let powerLabelUpdateInterval = 0.5
+  private static let renderTraceWindowDuration = 1.0
 
   private static let activityViewDuration = 3.0
   private static let activityViewLatency = 0.1
   private static let activityViewExtraBufferingDuration = activityViewLatency * 2
-  private static let dropoutColor = UIColor.red
+  static let dropoutColor = UIColor.red
   private static let threadColors = [
     UIColor.black,
     UIColor.systemBlue,
@@ -93,6 +113,7 @@ class ViewController: UITableViewController {
     tableViewHeader("Work Distribution")!.isExpanded = false
     tableViewHeader("Cores")!.isExpanded = false
     tableViewHeader("Energy")!.isExpanded = false
+    tableViewHeader("Slowest Render")!.isExpanded = false
 
     displayLink = CADisplayLink(target: self, selector: #selector(displayLinkStep))
     displayLink!.add(to: .main, forMode: RunLoop.Mode.common)
@@ -106,6 +127,9 @@ class ViewController: UITableViewController {
     busyThreadCpuUsageSlider.valueFormatter = percentageFormatter
     busyThreadPeriodSlider.valueFormatter =
       { (value: Float) in return "\(Int(value * 1000))ms"}
+    chunkSchedulingSlider.valueFormatter = { (value: Float) in
+      return ViewController.chunkSchedulingNames[Int(value.rounded())]
+    }
 
     numSinesSlider.minimumValue = Float(engine.numSines)
     numProcessingThreadsSlider.maximumValue = Float(numberOfProcessors)
@@ -184,13 +208,27 @@ class ViewController: UITableViewController {
     processInDriverThreadControl.selectedSegmentIndex =
       engine.processInDriverThread ? 1 : 0
     isWorkIntervalOnSwitch.isOn = engine.isWorkIntervalOn
+    workerDispatchControl.selectedSegmentIndex = engine.workerDispatch.rawValue
+    isWorkerGovernorOnSwitch.isOn = engine.isWorkerGovernorOn
+    isDemandWakeupOnSwitch.isOn = engine.isDemandWakeupOn
+    isPipelinedSwitch.isOn = engine.isPipelined
+
+    sineKernelControl.selectedSegmentIndex = engine.sineKernel.rawValue
+    chunkSchedulingSlider.value = Float(engine.chunkScheduling.rawValue)
+    isSessionGraphOnSwitch.isOn = engine.isSessionGraphOn
+    isPartialSheddingOnSwitch.isOn = engine.isPartialSheddingOn
+    isQualityGovernorOnSwitch.isOn = engine.isQualityGovernorOn
 
     updateThreadDependentControls()
     updatePresetControl()
   }
 
   private func updateThreadDependentControls() {
-    isWorkIntervalOnSwitch.isEnabled = engine.numWorkerThreads > 0
+    let hasWorkerThreads = engine.numWorkerThreads > 0
+    isWorkIntervalOnSwitch.isEnabled = hasWorkerThreads
+    workerDispatchControl.isEnabled = hasWorkerThreads
+    isWorkerGovernorOnSwitch.isEnabled = hasWorkerThreads
+    isDemandWakeupOnSwitch.isEnabled = hasWorkerThreads
     workDistributionOneThreadWarning.isHidden = engine.numProcessingThreads > 1
   }
 
@@ -290,6 +328,70 @@ class ViewController: UITableViewController {
     updatePresetControl()
   }
 
+  @IBAction private func workerDispatchChanged(_ sender: Any) {
+    engine.workerDispatch =
+      WorkerDispatch(rawValue: workerDispatchControl.selectedSegmentIndex)!
+    updatePresetControl()
+  }
+
+  @IBAction private func isWorkerGovernorOnChanged(_ sender: Any) {
+    engine.isWorkerGovernorOn = isWorkerGovernorOnSwitch.isOn
+    updatePresetControl()
+  }
+
+  @IBAction private func isDemandWakeupOnChanged(_ sender: Any) {
+    engine.isDemandWakeupOn = isDemandWakeupOnSwitch.isOn
+    updatePresetControl()
+  }
+
+  @IBAction private func isPipelinedChanged(_ sender: Any) {
+    engine.isPipelined = isPipelinedSwitch.isOn
+    updatePresetControl()
+  }
+
+  @IBAction private func sineKernelChanged(_ sender: Any) {
+    engine.sineKernel = SineKernel(rawValue: sineKernelControl.selectedSegmentIndex)!
+  }
+
+  @IBAction private func chunkSchedulingChanged(_ sender: Any) {
+    // Snap to the nearest mode since the slider is continuous
+    engine.chunkScheduling =
+      ChunkScheduling(rawValue: Int(chunkSchedulingSlider.value.rounded()))!
+    chunkSchedulingSlider.value = Float(engine.chunkScheduling.rawValue)
+  }
+
+  @IBAction private func isSessionGraphOnChanged(_ sender: Any) {
+    engine.isSessionGraphOn = isSessionGraphOnSwitch.isOn
+  }
+
+  @IBAction private func isPartialSheddingOnChanged(_ sender: Any) {
+    engine.isPartialSheddingOn = isPartialSheddingOnSwitch.isOn
+  }
+
+  @IBAction private func isQualityGovernorOnChanged(_ sender: Any) {
+    engine.isQualityGovernorOn = isQualityGovernorOnSwitch.isOn
+  }
+
+  @IBAction private func renderOffline(_ sender: Any) {
+    // Blocks the main thread, but keeps the render from racing with other controls
+    let measurement =
+      engine.renderOffline(for: ViewController.offlineRenderDuration, wavFilePath: nil)
+
+    let message = measurement.numFrames > 0
+      ? String(
+          format: "%.1fx real-time\n%.0f partial frames/s\n"
+            + "Buffers: %.3f ms mean, %.3f ms max",
+          measurement.framesPerSecond / engine.sampleRate,
+          measurement.partialFramesPerSecond,
+          measurement.meanBufferDuration * 1000.0,
+          measurement.maxBufferDuration * 1000.0)
+      : "The render failed"
+    let alert = UIAlertController(
+      title: "Offline Render", message: message, preferredStyle: .alert)
+    alert.addAction(UIAlertAction(title: "OK", style: .default))
+    present(alert, animated: true)
+  }
+
   @IBAction private func playSineBurst(_ sender: Any) {
     engine.playSineBurst(for: 0.25, additionalSines: Int32(numBurstSinesSlider.value))
   }
@@ -438,6 +540,45 @@ class ViewController: UITableViewController {
     })
   }
 
+  private func fetchRenderTraces() {
+    engine.fetchRenderTraces({ trace in
+      let renderDuration = trace.renderEndedEnd - trace.renderStart
+      if trace.renderStart >= 0 && renderDuration > self.slowestRenderDuration {
+        self.slowestRenderTrace = trace
+        self.slowestRenderDuration = renderDuration
+      }
+    })
+
+    // Show the slowest render per window instead of the slowest ever, so that an early
+    // outlier (e.g. at launch) doesn't hide later ones
+    let time = CACurrentMediaTime()
+    if let lastRenderTraceWindowTime = lastRenderTraceWindowTime,
+       (time - lastRenderTraceWindowTime) <= ViewController.renderTraceWindowDuration {
+      return
+    }
+
+    if let trace = slowestRenderTrace, let numFrames = lastNumFrames {
+      let bufferDuration = Double(numFrames) / engine.sampleRate
+      tableViewHeader("Slowest Render")!.value =
+        String(format: "%.2f ms", slowestRenderDuration * 1000.0)
+      if slowestRenderDuration > bufferDuration {
+        os_log(
+          "Slow Render: %.3f ms (processing %.3f ms, %d threads)",
+          slowestRenderDuration * 1000.0,
+          (trace.processEnd - trace.renderStartedEnd) * 1000.0,
+          trace.numProcessingThreads)
+      }
+      if visualizationsOnSwitch.isOn {
+        renderTraceView.bufferDuration = bufferDuration
+        renderTraceView.trace = trace
+      }
+    }
+
+    lastRenderTraceWindowTime = time
+    slowestRenderTrace = nil
+    slowestRenderDuration = 0.0
+  }
+
   private func fetchPowerMeasurements() {
     let energyHeader = tableViewHeader("Energy")!
     guard let energyUsage = taskEnergyUsage else {
@@ -501,6 +642,7 @@ class ViewController: UITableViewController {
 
   @objc private func displayLinkStep(displayLink: CADisplayLink) {
     fetchDriveMeasurements()
+    fetchRenderTraces()
     fetchPowerMeasurements()
 
     let startTime = displayLink.timestamp -
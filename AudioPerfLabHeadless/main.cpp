@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*! A command line host that renders ParallelSineBank through AudioHost without the app.
+ *
+ * On Linux, the driver plays to a SimulatedDevice, which allows measuring dropouts and
+ * throughput on machines without CoreAudio.
+ */
+
+#include "Constants.hpp"
+#include "ParallelSineBank.hpp"
+#include "Partial.hpp"
+
+#include "Base/AudioHost.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct Options
+{
+  double duration{2.0};
+  std::optional<int> numSines;
+  std::optional<int> numProcessingThreads;
+  int bufferSize{kDefaultPreferredBufferSize};
+  bool isOffline{false};
+  std::optional<std::string> wavFilePath;
+};
+
+void printUsage(const char* pProgramName)
+{
+  std::fprintf(stderr,
+               "Usage: %s [--duration SECONDS] [--sines N] [--threads N]\n"
+               "          [--buffer-size FRAMES] [--offline] [--wav PATH]\n",
+               pProgramName);
+}
+
+Options parseOptions(const int argc, char* argv[])
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string option = argv[i];
+    const auto value = [&] {
+      if (i + 1 >= argc)
+      {
+        throw std::invalid_argument{"Missing value for " + option};
+      }
+      return std::string{argv[++i]};
+    };
+
+    if (option == "--duration")
+    {
+      options.duration = std::stod(value());
+    }
+    else if (option == "--sines")
+    {
+      options.numSines = std::stoi(value());
+    }
+    else if (option == "--threads")
+    {
+      options.numProcessingThreads = std::stoi(value());
+    }
+    else if (option == "--buffer-size")
+    {
+      options.bufferSize = std::stoi(value());
+    }
+    else if (option == "--offline")
+    {
+      options.isOffline = true;
+    }
+    else if (option == "--wav")
+    {
+      options.wavFilePath = value();
+    }
+    else
+    {
+      throw std::invalid_argument{"Unknown option " + option};
+    }
+  }
+  return options;
+}
+
+std::vector<float> duplicateChord(const int numChords)
+{
+  std::vector<float> result;
+  for (int i = 0; i < numChords; ++i)
+  {
+    std::copy(kChordNoteNumbers.begin(), kChordNoteNumbers.end(),
+              std::back_inserter(result));
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  try
+  {
+    options = parseOptions(argc, argv);
+  }
+  catch (const std::exception& exception)
+  {
+    std::fprintf(stderr, "%s\n", exception.what());
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Like the app, play one chord per core so that the default load scales with the system
+  const auto numChords = std::max(int(std::thread::hardware_concurrency()), 1);
+  const auto numSines = options.numSines.value_or(kDefaultNumSines * numChords);
+
+  ParallelSineBank sineBank;
+  AudioHost::ProcessingThreads processingThreads;
+  std::atomic<int> numBuffers{0};
+  AudioHost host{
+    [&](const int maxNumProcessingThreads) {
+      sineBank.setMaxNumThreads(maxNumProcessingThreads);
+    },
+    [&](StereoAudioBufferPtrs,
+        const int numFrames,
+        const AudioHost::ProcessingThreads& threads) {
+      processingThreads = threads;
+      sineBank.setNumThreads(threads.numProcessingThreads);
+      sineBank.prepare(numSines, numFrames);
+    },
+    [&](const int threadIndex, const int numFrames, const Deadline& deadline) {
+      const auto processingThreadIndex =
+        threadIndex - (processingThreads.processInDriverThread ? 0 : 1);
+      sineBank.process(processingThreadIndex, numFrames, deadline);
+    },
+    [&](const StereoAudioBufferPtrs ioBuffer, uint64_t, const int numFrames) {
+      sineBank.mixTo(ioBuffer, numFrames);
+      ++numBuffers;
+    }};
+
+  const auto sampleRate = float(host.driver().sampleRate());
+  const auto chord =
+    generateChord(sampleRate, kAmpSmoothingDuration, duplicateChord(numChords));
+  sineBank.setPartials(randomizePhases(toPartials(chord), kNumUnrandomizedPhases));
+  sineBank.setHarmonicStacks(randomizePhases(chord, kNumUnrandomizedPhases));
+
+  if (options.numProcessingThreads)
+  {
+    host.setNumProcessingThreads(*options.numProcessingThreads);
+  }
+  host.setPreferredBufferSize(options.bufferSize);
+
+  std::printf("Rendering %d sines with %d processing threads in buffers of %d frames\n",
+              std::min(numSines, sineBank.numPartials()), host.numProcessingThreads(),
+              host.preferredBufferSize());
+
+  if (options.isOffline)
+  {
+    try
+    {
+      const auto stats = host.renderOffline(
+        int(options.duration * sampleRate), options.wavFilePath);
+      const auto maxBufferDuration =
+        stats.bufferDurations.empty()
+          ? 0.0
+          : std::max_element(stats.bufferDurations.begin(), stats.bufferDurations.end())
+              ->count();
+      std::printf("Rendered %d frames in %.3f s: %.0f frames/s, max buffer %.3f ms\n",
+                  stats.numFrames, stats.renderDuration().count(),
+                  stats.framesPerSecond(), maxBufferDuration * 1000.0);
+    }
+    catch (const std::runtime_error& exception)
+    {
+      std::fprintf(stderr, "Offline render failed: %s\n", exception.what());
+      return EXIT_FAILURE;
+    }
+  }
+  else
+  {
+    host.start();
+    std::this_thread::sleep_for(std::chrono::duration<double>{options.duration});
+    host.stop();
+
+    std::printf("Rendered %d buffers, %llu missed deadlines\n", numBuffers.load(),
+                static_cast<unsigned long long>(host.driver().numMissedDeadlines()));
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -23,19 +23,70 @@
 #include "AudioHost.hpp"
 
 #include "Assert.hpp"
+#include "CycleCounter.hpp"
+#include "Log.hpp"
 #include "Thread.hpp"
+#include "WavFileWriter.hpp"
 
+#include <algorithm>
+#include <numeric>
 #include <string>
+#include <system_error>
 #include <utility>
 
+namespace
+{
+
+constexpr uint64_t kNumWorkersBits = 16;
+constexpr uint64_t kNumWorkersMask = (uint64_t(1) << kNumWorkersBits) - 1;
+
+/*! The fraction of the nominal buffer duration that processing threads can use before
+ * their deadline expires
+ */
+constexpr auto kProcessingBudget = 0.8;
+
+//! Make the calling thread real-time, or log why it keeps running without guarantees
+void setCurrentThreadRealtime(const std::chrono::duration<double> bufferDuration)
+{
+  try
+  {
+    setThreadTimeConstraintPolicy(
+      pthread_self(),
+      TimeConstraintPolicy{bufferDuration, kRealtimeThreadQuantum, bufferDuration});
+  }
+  catch (const std::system_error& error)
+  {
+    // Keep running without real-time guarantees, e.g., when lacking the privileges
+    BASE_LOG_ERROR("%s isn't real-time: %s", currentThreadName().c_str(), error.what());
+  }
+}
+
+int numWorkersInRound(const uint64_t round) { return int(round & kNumWorkersMask); }
+
+uint64_t nextRound(const uint64_t round, const int numWorkers)
+{
+  return (((round >> kNumWorkersBits) + 1) << kNumWorkersBits) | uint64_t(numWorkers);
+}
+
+} // namespace
+
+int AudioHost::ProcessingThreads::numWorkerThreads() const
+{
+  return numProcessingThreads - (processInDriverThread ? 1 : 0);
+}
+
 AudioHost::AudioHost(Setup setup,
                      RenderStarted renderStarted,
                      Process process,
-                     RenderEnded renderEnded)
+                     RenderEnded renderEnded,
+                     EstimateWork estimateWork,
+                     BeginBuffer beginBuffer)
   : mSetup{std::move(setup)}
   , mRenderStarted{std::move(renderStarted)}
   , mProcess{std::move(process)}
   , mRenderEnded{std::move(renderEnded)}
+  , mEstimateWork{std::move(estimateWork)}
+  , mBeginBuffer{std::move(beginBuffer)}
 {
   setupDriver(Driver::Config{});
   mNumProcessingThreads =
@@ -55,9 +106,11 @@ void AudioHost::start()
 {
   if (!mIsStarted)
   {
-    mSetup(mNumProcessingThreads);
-
-    setupWorkerThreads();
+    setupProcessingThreads();
+    if (mIsPipelined)
+    {
+      setupPipelineThread();
+    }
     driver().start();
     mIsStarted = true;
   }
@@ -68,6 +121,7 @@ void AudioHost::stop()
   if (mIsStarted)
   {
     driver().stop();
+    teardownPipelineThread();
     teardownWorkerThreads();
     mIsStarted = false;
   }
@@ -80,19 +134,39 @@ AudioHostConfig AudioHost::config() const
     .processInDriverThread = processInDriverThread(),
     .isWorkIntervalOn = isWorkIntervalOn(),
     .minimumLoad = minimumLoad(),
+    .workerSpinDuration = workerSpinDuration(),
+    .workerDispatch = workerDispatch(),
+    .isWorkerGovernorOn = isWorkerGovernorOn(),
+    .isPipelined = isPipelined(),
   };
 }
 void AudioHost::setConfig(const AudioHostConfig& newConfig)
 {
   if (newConfig != config())
   {
-    whileStopped([&] {
-      mNumProcessingThreads =
-        newConfig.numProcessingThreads.value_or(mAudioWorkgroup->maxNumParallelThreads());
+    const auto numProcessingThreads =
+      newConfig.numProcessingThreads.value_or(mAudioWorkgroup->maxNumParallelThreads());
+    const auto apply = [&] {
+      mNumProcessingThreads = numProcessingThreads;
       mProcessInDriverThread = newConfig.processInDriverThread;
       mIsWorkIntervalOn = newConfig.isWorkIntervalOn;
       mMinimumLoad = newConfig.minimumLoad;
-    });
+      mWorkerSpinDuration = newConfig.workerSpinDuration.count();
+      mWorkerDispatch = newConfig.workerDispatch;
+      mIsWorkerGovernorOn = newConfig.isWorkerGovernorOn;
+      mIsPipelined = newConfig.isPipelined;
+    };
+
+    if (newConfig.workerDispatch != mWorkerDispatch
+        || newConfig.isPipelined != mIsPipelined
+        || numProcessingThreads > mMaxNumProcessingThreads)
+    {
+      whileStopped(apply);
+    }
+    else
+    {
+      apply();
+    }
   }
 }
 
@@ -122,42 +196,184 @@ void AudioHost::setPreferredBufferSize(const int preferredBufferSize)
   }
 }
 
+#if !defined(__APPLE__)
+SimulatedDevice::Config AudioHost::simulatedDeviceConfig() const
+{
+  return driver().config().simulatedDevice;
+}
+
+void AudioHost::setSimulatedDeviceConfig(const SimulatedDevice::Config& deviceConfig)
+{
+  whileStopped([&] {
+    auto config = driver().config();
+    config.simulatedDevice = deviceConfig;
+
+    teardownDriver();
+    setupDriver(config);
+  });
+}
+#endif
+
 int AudioHost::numWorkerThreads() const
 {
-  return mNumProcessingThreads - (mProcessInDriverThread ? 1 : 0);
+  return ProcessingThreads{mNumProcessingThreads, mProcessInDriverThread}
+    .numWorkerThreads();
 }
 
+int AudioHost::maxNumProcessingThreads() const { return mMaxNumProcessingThreads; }
+
 int AudioHost::numProcessingThreads() const { return mNumProcessingThreads; }
 void AudioHost::setNumProcessingThreads(const int numProcessingThreads)
 {
   assertRelease(numProcessingThreads > 0, "Invalid number of processing threads");
 
-  if (numProcessingThreads != mNumProcessingThreads)
+  if (mIsStarted && numProcessingThreads > mMaxNumProcessingThreads)
   {
+    // Grow the pool
     whileStopped([&] { mNumProcessingThreads = numProcessingThreads; });
   }
+  else
+  {
+    mNumProcessingThreads = numProcessingThreads;
+  }
 }
 
 bool AudioHost::processInDriverThread() const { return mProcessInDriverThread; }
 void AudioHost::setProcessInDriverThread(const bool isEnabled)
 {
-  if (isEnabled != mProcessInDriverThread)
+  mProcessInDriverThread = isEnabled;
+}
+
+bool AudioHost::isWorkIntervalOn() const { return mIsWorkIntervalOn; }
+void AudioHost::setIsWorkIntervalOn(const bool isOn) { mIsWorkIntervalOn = isOn; }
+
+double AudioHost::minimumLoad() const { return mMinimumLoad; }
+void AudioHost::setMinimumLoad(const double minimumLoad) { mMinimumLoad = minimumLoad; }
+
+AudioHost::WorkerDispatch AudioHost::workerDispatch() const { return mWorkerDispatch; }
+void AudioHost::setWorkerDispatch(const WorkerDispatch dispatch)
+{
+  if (dispatch != mWorkerDispatch)
   {
-    whileStopped([&] { mProcessInDriverThread = isEnabled; });
+    whileStopped([&] { mWorkerDispatch = dispatch; });
   }
 }
 
-bool AudioHost::isWorkIntervalOn() const { return mIsWorkIntervalOn; }
-void AudioHost::setIsWorkIntervalOn(const bool isOn)
+std::chrono::duration<double> AudioHost::workerSpinDuration() const
+{
+  return std::chrono::duration<double>{mWorkerSpinDuration};
+}
+void AudioHost::setWorkerSpinDuration(const std::chrono::duration<double> duration)
+{
+  mWorkerSpinDuration = duration.count();
+}
+
+bool AudioHost::isWorkerGovernorOn() const { return mIsWorkerGovernorOn; }
+void AudioHost::setIsWorkerGovernorOn(const bool isOn) { mIsWorkerGovernorOn = isOn; }
+
+bool AudioHost::isPipelined() const { return mIsPipelined; }
+void AudioHost::setIsPipelined(const bool isPipelined)
 {
-  if (isOn != mIsWorkIntervalOn)
+  if (isPipelined != mIsPipelined)
   {
-    whileStopped([&] { mIsWorkIntervalOn = isOn; });
+    whileStopped([&] { mIsPipelined = isPipelined; });
   }
 }
 
-double AudioHost::minimumLoad() const { return mMinimumLoad; }
-void AudioHost::setMinimumLoad(const double minimumLoad) { mMinimumLoad = minimumLoad; }
+AudioHost::CallbackTiming AudioHost::lastCallbackTiming() const
+{
+  return {std::chrono::duration<double>{mLastCallbackDuration},
+          std::chrono::duration<double>{mLastOutputLatency}};
+}
+
+AudioHost::WorkerWakeup AudioHost::workerWakeup(const int threadIndex) const
+{
+  assertRelease(threadIndex >= 1 && threadIndex <= int(mWorkerStates.size()),
+                "Invalid worker thread index");
+  return mWorkerStates[threadIndex - 1].wakeup;
+}
+
+std::optional<AudioHost::RenderTrace> AudioHost::popRenderTrace()
+{
+  const auto* pTrace = mRenderTraces.front();
+  const auto result = pTrace ? std::make_optional(*pTrace) : std::nullopt;
+  mRenderTraces.popFront();
+  return result;
+}
+
+std::chrono::duration<double> AudioHost::OfflineRenderStats::renderDuration() const
+{
+  return std::accumulate(
+    bufferDurations.begin(), bufferDurations.end(), std::chrono::duration<double>{});
+}
+
+double AudioHost::OfflineRenderStats::framesPerSecond() const
+{
+  const auto duration = renderDuration().count();
+  return duration > 0.0 ? numFrames / duration : 0.0;
+}
+
+AudioHost::OfflineRenderStats AudioHost::renderOffline(
+  const int numFrames, const std::optional<std::string>& wavFilePath)
+{
+  assertRelease(numFrames >= 0, "Invalid number of frames");
+
+  std::optional<WavFileWriter> wavFileWriter;
+  if (wavFilePath)
+  {
+    wavFileWriter.emplace(*wavFilePath, driver().sampleRate());
+  }
+
+  OfflineRenderStats stats;
+  whileStopped([&] {
+    const auto bufferSize = preferredBufferSize();
+    StereoAudioBuffer buffer{
+      std::vector<float>(size_t(bufferSize)), std::vector<float>(size_t(bufferSize))};
+    const StereoAudioBufferPtrs bufferPtrs{buffer[0].data(), buffer[1].data()};
+    StereoAudioBufferList bufferList{};
+    bufferList.list.mNumberBuffers = 2;
+
+    mIsRenderingOffline = true;
+    setupProcessingThreads();
+
+    stats.numFrames = numFrames;
+    for (int frame = 0; frame < numFrames; frame += bufferSize)
+    {
+      const auto numBufferFrames = std::min(bufferSize, numFrames - frame);
+      const auto numBytes = UInt32(size_t(numBufferFrames) * sizeof(float));
+      std::fill(buffer[0].begin(), buffer[0].end(), 0.0f);
+      std::fill(buffer[1].begin(), buffer[1].end(), 0.0f);
+      bufferList.list.mBuffers[0] = AudioBuffer{1, numBytes, bufferPtrs[0]};
+      bufferList.secondBuffer = AudioBuffer{1, numBytes, bufferPtrs[1]};
+
+      AudioTimeStamp timeStamp{};
+      timeStamp.mSampleTime = frame;
+      timeStamp.mHostTime = currentMachAbsoluteTime();
+      timeStamp.mRateScalar = 1.0;
+      timeStamp.mFlags = kAudioTimeStampSampleTimeValid | kAudioTimeStampHostTimeValid;
+
+      AudioUnitRenderActionFlags actionFlags{};
+      const auto startTime = Clock::now();
+      render(&actionFlags, &timeStamp, 0, UInt32(numBufferFrames), &bufferList.list);
+      stats.bufferDurations.push_back(Clock::now() - startTime);
+
+      if (wavFileWriter)
+      {
+        wavFileWriter->write(bufferPtrs, numBufferFrames);
+      }
+    }
+
+    teardownWorkerThreads();
+    mIsRenderingOffline = false;
+  });
+
+  if (wavFileWriter)
+  {
+    wavFileWriter->close();
+  }
+
+  return stats;
+}
 
 void AudioHost::whileStopped(const std::function<void()>& f)
 {
@@ -180,6 +396,7 @@ void AudioHost::setupDriver(const Driver::Config config)
   assertRelease(!mDriver, "The driver must be torn down before calling setupDriver()");
   mDriver.emplace([this](const auto... xs) { return this->render(xs...); }, config);
 
+#if defined(__APPLE__)
   if (__builtin_available(iOS 14, *))
   {
     if (const auto maybeWorkgroup = driver().workgroup())
@@ -188,6 +405,7 @@ void AudioHost::setupDriver(const Driver::Config config)
       return;
     }
   }
+#endif
 
   // Fallback to the legacy workgroup
   mAudioWorkgroup.emplace(LegacyAudioWorkgroup{});
@@ -199,30 +417,76 @@ void AudioHost::teardownDriver()
   mAudioWorkgroup = std::nullopt;
 }
 
+void AudioHost::setupProcessingThreads()
+{
+  mMaxNumProcessingThreads =
+    std::max(mAudioWorkgroup->maxNumParallelThreads(), mNumProcessingThreads.load());
+  mSetup(mMaxNumProcessingThreads);
+  setupWorkerThreads();
+}
+
 void AudioHost::setupWorkerThreads()
 {
   assertRelease(mWorkerThreads.empty(),
                 "Worker threads must be torn down before calling setupWorkerThreads()");
 
+  // Every processing thread can be a worker when not processing in the driver thread
+  const auto numPoolWorkers = mMaxNumProcessingThreads;
   mAreWorkerThreadsActive = true;
-  for (int i = 1; i <= numWorkerThreads(); ++i)
+  mWorkerStates = std::vector<WorkerState>(numPoolWorkers);
+  mForkJoinBarrier.emplace(numPoolWorkers);
+
+  // Pass the current round so that workers can't miss a buffer that starts before
+  // they run for the first time.
+  const uint64_t round = mWorkerDispatch == WorkerDispatch::forkJoinBarrier
+                           ? mForkJoinBarrier->round()
+                           : mWorkRound.load();
+  for (int i = 1; i <= numPoolWorkers; ++i)
   {
-    mWorkerThreads.emplace_back(&AudioHost::workerThread, this, i);
+    mWorkerThreads.emplace_back(&AudioHost::workerThread, this, i, round);
   }
 }
 
 void AudioHost::teardownWorkerThreads()
 {
   mAreWorkerThreadsActive = false;
-  for (size_t i = 0; i < mWorkerThreads.size(); ++i)
-  {
-    mStartWorkingSemaphore.post();
-  }
+  wakeWorkerThreads(int(mWorkerThreads.size()));
   for (auto& thread : mWorkerThreads)
   {
     thread.join();
   }
   mWorkerThreads.clear();
+  mWorkerStates.clear();
+  mForkJoinBarrier = std::nullopt;
+}
+
+void AudioHost::setupPipelineThread()
+{
+  for (auto& buffer : mPipelineBuffers)
+  {
+    buffer = {std::vector<float>(kMaxPipelinedBufferSize),
+              std::vector<float>(kMaxPipelinedBufferSize)};
+  }
+  mIsPipelineRendering = false;
+  mIsPipelineThreadActive = true;
+  mPipelineThread = std::thread{&AudioHost::pipelineThread, this};
+}
+
+void AudioHost::teardownPipelineThread()
+{
+  if (!mPipelineThread.joinable())
+  {
+    return;
+  }
+
+  if (mIsPipelineRendering)
+  {
+    mPipelineDoneSemaphore.wait();
+    mIsPipelineRendering = false;
+  }
+  mIsPipelineThreadActive = false;
+  mPipelineRenderSemaphore.post();
+  mPipelineThread.join();
 }
 
 void AudioHost::ensureMinimumLoad(const std::chrono::time_point<Clock> bufferStartTime,
@@ -233,6 +497,24 @@ void AudioHost::ensureMinimumLoad(const std::chrono::time_point<Clock> bufferSta
   lowEnergyWorkUntil(bufferStartTime + (bufferDuration * double(mMinimumLoad)));
 }
 
+void AudioHost::updateWorkgroupMembership(
+  std::optional<SomeAudioWorkgroup::ScopedMembership>& membership)
+{
+  // Join after waking up to ensure that the CoreAudio thread is
+  // active so that LegacyAudioWorkgroup can find its work interval.
+  if (mIsWorkIntervalOn && !mIsRenderingOffline)
+  {
+    if (!membership)
+    {
+      membership = mAudioWorkgroup->join();
+    }
+  }
+  else
+  {
+    membership = std::nullopt;
+  }
+}
+
 OSStatus AudioHost::render(AudioUnitRenderActionFlags* ioActionFlags,
                            const AudioTimeStamp* inTimeStamp,
                            UInt32 inBusNumber,
@@ -240,67 +522,343 @@ OSStatus AudioHost::render(AudioUnitRenderActionFlags* ioActionFlags,
                            AudioBufferList* ioData)
 {
   const auto startTime = Clock::now();
-  mNumFrames = inNumberFrames;
+  const auto startCycles = readCycleCounter();
 
   const AudioBuffer* pIoBuffers = ioData->mBuffers;
   const StereoAudioBufferPtrs ioBuffer{
     static_cast<float*>(pIoBuffers[0].mData), static_cast<float*>(pIoBuffers[1].mData)};
 
-  mRenderStarted(ioBuffer, inNumberFrames);
+  if (mPipelineThread.joinable())
+  {
+    renderPipelined(ioBuffer, inTimeStamp->mHostTime, int(inNumberFrames), startTime);
+  }
+  else
+  {
+    const auto threads = renderBuffer(ioBuffer, inTimeStamp->mHostTime, inNumberFrames);
+    mLastOutputLatency = std::chrono::duration<double>{Clock::now() - startTime}.count();
+
+    if (threads.processInDriverThread && !mIsRenderingOffline)
+    {
+      ensureMinimumLoad(startTime, inNumberFrames);
+    }
+
+    if (!mIsRenderingOffline)
+    {
+      mRenderTrace.callbackStartTime = startCycles;
+      mRenderTrace.callbackEndTime = readCycleCounter();
+      mRenderTraces.tryPushBack(mRenderTrace);
+    }
+  }
+
+  mLastCallbackDuration = std::chrono::duration<double>{Clock::now() - startTime}.count();
+  return noErr;
+}
+
+AudioHost::ProcessingThreads AudioHost::renderBuffer(const StereoAudioBufferPtrs ioBuffer,
+                                                     const uint64_t hostTime,
+                                                     const int numFrames)
+{
+  const auto startTime = Clock::now();
+  mRenderTrace.renderStartTime = readCycleCounter();
+  mNumFrames = numFrames;
+  if (mBeginBuffer)
+  {
+    mBeginBuffer(numFrames);
+  }
+
+  // Latch the threads so that changes only take effect at buffer boundaries
+  const auto numProcessingThreads = mNumProcessingThreads.load();
+  const auto isWorkerGovernorOn = mIsWorkerGovernorOn.load();
+  if (isWorkerGovernorOn && !mWasWorkerGovernorOn)
+  {
+    mWorkerGovernor.reset(numProcessingThreads);
+  }
+  mWasWorkerGovernorOn = isWorkerGovernorOn;
+  const auto estimate = mEstimateWork ? mEstimateWork(numFrames) : std::nullopt;
+  if (isWorkerGovernorOn && estimate)
+  {
+    mWorkerGovernor.anticipateWork(estimate->numWorkUnits, numProcessingThreads);
+  }
+  const ProcessingThreads threads{
+    std::min(isWorkerGovernorOn ? mWorkerGovernor.numThreads() : numProcessingThreads,
+             numThreadsForEstimatedWork(estimate, numProcessingThreads)),
+    mProcessInDriverThread};
+  mRenderStarted(ioBuffer, numFrames, threads);
+  mRenderTrace.renderStartedEndTime = readCycleCounter();
+  mRenderTrace.threads = threads;
+
+  mBufferStartTime = startTime;
+  mDeadline = mIsRenderingOffline
+                ? Deadline{}
+                : Deadline{startTime
+                           + std::chrono::duration_cast<Clock::duration>(
+                             kProcessingBudget * driver().nominalBufferDuration())};
+  wakeWorkerThreads(threads.numWorkerThreads());
+
+  Clock::duration busyDuration{};
+  auto& threadTraces = mRenderTrace.threadTraces;
+  std::fill(threadTraces.begin(), threadTraces.end(), ThreadTrace{});
+  if (threads.processInDriverThread)
+  {
+    const auto processStartTime = Clock::now();
+    threadTraces[0].processStartTime = readCycleCounter();
+    mProcess(0, numFrames, mDeadline);
+    threadTraces[0].processEndTime = readCycleCounter();
+    busyDuration += Clock::now() - processStartTime;
+  }
+
+  waitForWorkerThreads(threads.numWorkerThreads());
+  mRenderTrace.processEndTime = readCycleCounter();
+  for (int i = 0; i < std::min(threads.numWorkerThreads(), kMaxNumTracedThreads - 1); ++i)
+  {
+    threadTraces[i + 1] = mWorkerStates[i].trace;
+  }
+
+  if (isWorkerGovernorOn)
+  {
+    for (int i = 0; i < threads.numWorkerThreads(); ++i)
+    {
+      busyDuration += mWorkerStates[i].processDuration;
+    }
+    const auto bufferDuration =
+      std::chrono::duration<double>{numFrames / driver().sampleRate()};
+    mWorkerGovernor.update(
+      busyDuration, Clock::now() - startTime, bufferDuration, numProcessingThreads);
+  }
+
+  mRenderEnded(ioBuffer, hostTime, numFrames);
+  mRenderTrace.renderEndedEndTime = readCycleCounter();
+
+  return threads;
+}
+
+void AudioHost::renderPipelined(const StereoAudioBufferPtrs ioBuffer,
+                                const uint64_t hostTime,
+                                const int numFrames,
+                                const Clock::time_point callbackStartTime)
+{
+  // The buffer requested by the previous callback has normally been finished long ago,
+  // unless rendering takes longer than a buffer duration.
+  const auto renderedBufferIndex = mPipelineBufferIndex;
+  const auto renderedRequestTime = mPipelineRequestTime;
+  auto numRenderedFrames = 0;
+  if (mIsPipelineRendering)
+  {
+    mPipelineDoneSemaphore.wait();
+    numRenderedFrames = mPipelineNumFrames;
+  }
+
+  // Start rendering the next buffer, passing it this buffer's input. Its host time is
+  // when the next callback is expected to deliver it.
+  const auto numNextFrames = std::min(numFrames, kMaxPipelinedBufferSize);
+  auto& nextBuffer = mPipelineBuffers[1 - renderedBufferIndex];
+  for (int channel = 0; channel < 2; ++channel)
+  {
+    std::copy_n(ioBuffer[channel], numNextFrames, nextBuffer[channel].begin());
+  }
+  mPipelineBufferIndex = 1 - renderedBufferIndex;
+  mPipelineNumFrames = numNextFrames;
+  const auto bufferDuration =
+    std::chrono::duration<double>{numFrames / driver().sampleRate()};
+  mPipelineHostTime = hostTime + secondsToMachAbsoluteTime(bufferDuration);
+  mPipelineRequestTime = callbackStartTime;
+  mIsPipelineRendering = true;
+  mPipelineRenderSemaphore.post();
+
+  // Deliver the rendered buffer. The first callback delivers silence.
+  const auto& renderedBuffer = mPipelineBuffers[renderedBufferIndex];
+  const auto numDeliveredFrames = std::min(numRenderedFrames, numFrames);
+  for (int channel = 0; channel < 2; ++channel)
+  {
+    std::copy_n(renderedBuffer[channel].begin(), numDeliveredFrames, ioBuffer[channel]);
+    std::fill_n(ioBuffer[channel] + numDeliveredFrames, numFrames - numDeliveredFrames,
+                0.0f);
+  }
+  if (numRenderedFrames > 0)
+  {
+    mLastOutputLatency =
+      std::chrono::duration<double>{Clock::now() - renderedRequestTime}.count();
+  }
+}
+
+int AudioHost::numThreadsForEstimatedWork(const std::optional<WorkEstimate>& estimate,
+                                          const int numProcessingThreads)
+{
+  if (!estimate || !estimate->limitsNumThreads)
+  {
+    return numProcessingThreads;
+  }
+
+  assertRelease(estimate->numWorkUnitsPerThread > 0, "Invalid work estimate");
+  const auto numThreads = (estimate->numWorkUnits + estimate->numWorkUnitsPerThread - 1)
+                          / estimate->numWorkUnitsPerThread;
+  return std::clamp(numThreads, 1, numProcessingThreads);
+}
 
-  for (size_t i = 0; i < mWorkerThreads.size(); ++i)
+void AudioHost::wakeWorkerThreads(const int numWorkerThreads)
+{
+  if (mWorkerDispatch == WorkerDispatch::forkJoinBarrier)
   {
-    mStartWorkingSemaphore.post();
+    mForkJoinBarrier->fork(numWorkerThreads);
+    return;
   }
 
-  if (mProcessInDriverThread)
+  // Spinning workers see the new round. Sleeping workers need a post, but only from
+  // whoever manages to clear their sleeping flag first (see waitForWork()). Workers that
+  // aren't part of this buffer stay asleep.
+  mWorkRound = nextRound(mWorkRound.load(std::memory_order_relaxed), numWorkerThreads);
+  for (int i = 0; i < numWorkerThreads; ++i)
   {
-    mProcess(0, inNumberFrames);
+    auto& workerState = mWorkerStates[i];
+    if (workerState.isSleeping.exchange(false))
+    {
+      workerState.wakeupSemaphore.post();
+    }
   }
+}
 
-  for (size_t i = 0; i < mWorkerThreads.size(); ++i)
+void AudioHost::waitForWorkerThreads(const int numWorkerThreads)
+{
+  if (mWorkerDispatch == WorkerDispatch::forkJoinBarrier)
+  {
+    mForkJoinBarrier->join();
+    return;
+  }
+
+  for (int i = 0; i < numWorkerThreads; ++i)
   {
     mFinishedWorkSemaphore.wait();
   }
+}
 
-  mRenderEnded(ioBuffer, inTimeStamp->mHostTime, inNumberFrames);
+bool AudioHost::waitForWork(const int threadIndex, uint64_t& round)
+{
+  if (mWorkerDispatch == WorkerDispatch::forkJoinBarrier)
+  {
+    auto barrierRound = uint32_t(round);
+    const auto wasSpinning =
+      mForkJoinBarrier->waitForFork(threadIndex, barrierRound, workerSpinDuration());
+    round = barrierRound;
+    return wasSpinning;
+  }
 
-  if (mProcessInDriverThread)
+  auto& state = mWorkerStates[threadIndex - 1];
+  auto spinEndTime =
+    Clock::now()
+    + std::chrono::duration_cast<Clock::duration>(workerSpinDuration());
+  while (true)
   {
-    ensureMinimumLoad(startTime, inNumberFrames);
+    const auto currentRound = mWorkRound.load(std::memory_order_acquire);
+    if (currentRound != round)
+    {
+      round = currentRound;
+      if (threadIndex <= numWorkersInRound(round))
+      {
+        return true;
+      }
+
+      // Not needed for this buffer, so go to sleep until a buffer posts this worker
+      spinEndTime = Clock::now();
+    }
+
+    if (Clock::now() >= spinEndTime)
+    {
+      // Announce that this thread is going to sleep before checking the round one last
+      // time, so that either this thread sees the new round or wakeWorkerThreads()
+      // sees the flag and posts.
+      state.isSleeping = true;
+      if (mWorkRound != round && state.isSleeping.exchange(false))
+      {
+        // A buffer started, but no post was sent since the flag was still set
+        continue;
+      }
+
+      // Only buffers this worker is part of post, and no buffer can start before it
+      // finished its share of the current one.
+      state.wakeupSemaphore.wait();
+      round = mWorkRound.load(std::memory_order_acquire);
+      return false;
+    }
+
+    hardwareDelay();
   }
+}
 
-  return noErr;
+void AudioHost::finishWork()
+{
+  if (mWorkerDispatch == WorkerDispatch::forkJoinBarrier)
+  {
+    mForkJoinBarrier->arrive();
+  }
+  else
+  {
+    mFinishedWorkSemaphore.post();
+  }
 }
 
-void AudioHost::workerThread(const int threadIndex)
+void AudioHost::workerThread(const int threadIndex, uint64_t round)
 {
   setCurrentThreadName("Audio Worker Thread " + std::to_string(threadIndex));
-  setThreadTimeConstraintPolicy(
-    pthread_self(),
-    TimeConstraintPolicy{driver().nominalBufferDuration(), kRealtimeThreadQuantum,
-                         driver().nominalBufferDuration()});
+  setCurrentThreadRealtime(driver().nominalBufferDuration());
 
   std::optional<SomeAudioWorkgroup::ScopedMembership> workgroupMembership;
   while (1)
   {
-    mStartWorkingSemaphore.wait();
+    const auto wasSpinning = waitForWork(threadIndex, round);
+    auto& state = mWorkerStates[threadIndex - 1];
+    state.trace.wakeTime = readCycleCounter();
     if (!mAreWorkerThreadsActive)
     {
       break;
     }
 
-    // Join after waking from the semaphore to ensure that the CoreAudio thread is
-    // active so that LegacyAudioWorkgroup can find its work interval.
-    if (mIsWorkIntervalOn && !workgroupMembership)
+    updateWorkgroupMembership(workgroupMembership);
+
+    const auto startTime = Clock::now();
+    state.wakeup = {startTime - mBufferStartTime, wasSpinning};
+
+    const auto numFrames = mNumFrames.load();
+    state.trace.processStartTime = readCycleCounter();
+    mProcess(threadIndex, numFrames, mDeadline);
+    state.trace.processEndTime = readCycleCounter();
+    state.processDuration = Clock::now() - startTime;
+    finishWork();
+    if (!mIsRenderingOffline)
     {
-      workgroupMembership = mAudioWorkgroup->join();
+      ensureMinimumLoad(startTime, numFrames);
     }
+  }
+}
+
+void AudioHost::pipelineThread()
+{
+  setCurrentThreadName("Audio Pipeline Thread");
+  setCurrentThreadRealtime(driver().nominalBufferDuration());
+
+  std::optional<SomeAudioWorkgroup::ScopedMembership> workgroupMembership;
+  while (1)
+  {
+    mPipelineRenderSemaphore.wait();
+    if (!mIsPipelineThreadActive)
+    {
+      break;
+    }
+
+    updateWorkgroupMembership(workgroupMembership);
 
     const auto startTime = Clock::now();
-    const auto numFrames = mNumFrames.load();
-    mProcess(threadIndex, numFrames);
-    mFinishedWorkSemaphore.post();
-    ensureMinimumLoad(startTime, numFrames);
+    const auto numFrames = mPipelineNumFrames;
+    auto& buffer = mPipelineBuffers[mPipelineBufferIndex];
+    const auto threads =
+      renderBuffer({buffer[0].data(), buffer[1].data()}, mPipelineHostTime, numFrames);
+    mRenderTrace.callbackStartTime = 0;
+    mRenderTrace.callbackEndTime = 0;
+    mRenderTraces.tryPushBack(mRenderTrace);
+    mPipelineDoneSemaphore.post();
+
+    if (threads.processInDriverThread)
+    {
+      ensureMinimumLoad(startTime, numFrames);
+    }
   }
 }
@@ -25,15 +25,20 @@
 #include "AudioBuffer.hpp"
 #include "AudioWorkgroup.hpp"
 #include "Config.hpp"
+#include "CoreAudioTypes.hpp"
+#include "Deadline.hpp"
 #include "Driver.hpp"
+#include "FixedSPSCQueue.hpp"
+#include "ForkJoinBarrier.hpp"
 #include "Semaphore.hpp"
+#include "WorkerGovernor.hpp"
 
-#include <CoreAudio/CoreAudioTypes.h>
 #include <array>
 #include <atomic>
 #include <chrono>
 #include <functional>
 #include <optional>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -47,17 +52,150 @@ class AudioHost
   using Clock = std::chrono::high_resolution_clock;
 
 public:
-  using Setup = std::function<void(int numProcessingThreads)>;
-  using RenderStarted =
-    std::function<void(StereoAudioBufferPtrs ioBuffer, int numFrames)>;
-  using Process = std::function<void(int threadIndex, int numFrames)>;
+  /*! The threads taking part in rendering a buffer.
+   *
+   * Uses fewer than numProcessingThreads() if the worker governor is on or the
+   * estimated work of the buffer doesn't need all of them.
+   */
+  struct ProcessingThreads
+  {
+    int numProcessingThreads{};
+    bool processInDriverThread{};
+
+    int numWorkerThreads() const;
+  };
+
+  //! The amount of work in a buffer, known before the processing threads are chosen
+  struct WorkEstimate
+  {
+    int numWorkUnits{};
+
+    //! The number of work units worth waking another processing thread for
+    int numWorkUnitsPerThread{1};
+
+    /*! Use only as many processing threads as the work needs. Otherwise the estimate is
+     * only used by the worker governor to notice when the work jumps.
+     */
+    bool limitsNumThreads{true};
+  };
+
+  using Setup = std::function<void(int maxNumProcessingThreads)>;
+  using RenderStarted = std::function<void(
+    StereoAudioBufferPtrs ioBuffer, int numFrames, const ProcessingThreads& threads)>;
+
+  /*! Called from each processing thread to render a share of the buffer.
+   *
+   * The deadline leaves the rest of the buffer duration for mixing and the driver. Work
+   * still pending when it expires can be skipped to avoid a dropout. Offline rendering
+   * passes a deadline that never expires.
+   */
+  using Process =
+    std::function<void(int threadIndex, int numFrames, const Deadline& deadline)>;
+
   using RenderEnded =
     std::function<void(StereoAudioBufferPtrs ioBuffer, uint64_t hostTime, int numFrames)>;
 
+  /*! Called at the start of each buffer, before EstimateWork and RenderStarted.
+   *
+   * Updates the state that both of them depend on, e.g. the amount of work to render
+   * in the buffer.
+   */
+  using BeginBuffer = std::function<void(int numFrames)>;
+
+  /*! Called at the start of each buffer, after BeginBuffer and before RenderStarted.
+   *
+   * If it returns an estimate that limits the number of threads, only
+   * ceil(numWorkUnits / numWorkUnitsPerThread) processing threads are used for the
+   * buffer, and the remaining workers stay parked.
+   * Must not have side effects; state that changes per buffer belongs in BeginBuffer.
+   */
+  using EstimateWork = std::function<std::optional<WorkEstimate>(int numFrames)>;
+
+  //! How a worker thread was woken up for the current buffer
+  struct WorkerWakeup
+  {
+    //! The time between the start of the buffer and the worker starting to process
+    std::chrono::duration<double> latency{};
+
+    //! True if the worker was spinning rather than blocked when the buffer started
+    bool wasSpinning{};
+  };
+
+  //! The timing of the most recent audio I/O callback
+  struct CallbackTiming
+  {
+    //! The time spent in the callback
+    std::chrono::duration<double> callbackDuration{};
+
+    /*! The time from the start of the callback that started rendering the delivered
+     * buffer until it was delivered.
+     *
+     * About the callback duration normally, and about one buffer duration longer when
+     * pipelined.
+     */
+    std::chrono::duration<double> outputLatency{};
+  };
+
+  //! Timestamps of one processing thread's work on a buffer, read with readCycleCounter()
+  struct ThreadTrace
+  {
+    //! When the worker stopped waiting for the buffer. Zero for the driver thread.
+    uint64_t wakeTime{};
+    uint64_t processStartTime{};
+    uint64_t processEndTime{};
+  };
+
+  /*! Timestamps of the stages of rendering a buffer, read with readCycleCounter().
+   *
+   * Separates the time threads take to wake up from the time they spend processing.
+   * Stages that didn't happen are zero.
+   */
+  struct RenderTrace
+  {
+    //! Entry into the audio I/O callback. Zero when pipelined.
+    uint64_t callbackStartTime{};
+
+    //! The start of rendering, in the callback or on the pipeline thread
+    uint64_t renderStartTime{};
+
+    uint64_t renderStartedEndTime{};
+
+    //! All processing threads have finished the buffer
+    uint64_t processEndTime{};
+
+    //! RenderEnded has returned, i.e. the buffer is mixed
+    uint64_t renderEndedEndTime{};
+
+    //! Exit from the audio I/O callback. Zero when pipelined.
+    uint64_t callbackEndTime{};
+
+    ProcessingThreads threads;
+
+    //! Indexed by thread index. Threads beyond kMaxNumTracedThreads aren't traced.
+    std::array<ThreadTrace, kMaxNumTracedThreads> threadTraces{};
+  };
+
+  //! The timing of a renderOffline() call
+  struct OfflineRenderStats
+  {
+    int numFrames{};
+
+    //! The time each buffer took, from calling RenderStarted until RenderEnded returned
+    std::vector<std::chrono::duration<double>> bufferDurations;
+
+    //! The time all buffers took, not including writing the WAV file
+    std::chrono::duration<double> renderDuration() const;
+
+    //! Frames rendered per second of renderDuration()
+    double framesPerSecond() const;
+  };
+
   AudioHost(Setup setup,
             RenderStarted renderStarted,
             Process process,
-            RenderEnded renderEnded);
+            RenderEnded renderEnded,
+            EstimateWork estimateWork = {},
+            BeginBuffer beginBuffer = {});
   ~AudioHost();
 
   Driver& driver();
@@ -78,8 +216,22 @@ public:
   int preferredBufferSize() const;
   void setPreferredBufferSize(const int preferredBufferSize);
 
+#if !defined(__APPLE__)
+  SimulatedDevice::Config simulatedDeviceConfig() const;
+  void setSimulatedDeviceConfig(const SimulatedDevice::Config& deviceConfig);
+#endif
+
   int numWorkerThreads() const;
 
+  /*! The size of the pool of processing threads, as passed to the Setup callback.
+   *
+   * The number of processing threads, whether to process in the driver thread, and
+   * whether to join the workgroup can be changed while running. They're applied at the
+   * next buffer boundary without stopping audio, as long as the number of processing
+   * threads doesn't exceed the pool size. Workers that aren't needed are parked.
+   */
+  int maxNumProcessingThreads() const;
+
   int numProcessingThreads() const;
   void setNumProcessingThreads(int numProcessingThreads);
 
@@ -92,45 +244,166 @@ public:
   double minimumLoad() const;
   void setMinimumLoad(double minimumLoad);
 
+  using WorkerDispatch = AudioHostConfig::WorkerDispatch;
+  WorkerDispatch workerDispatch() const;
+  void setWorkerDispatch(WorkerDispatch dispatch);
+
+  std::chrono::duration<double> workerSpinDuration() const;
+  void setWorkerSpinDuration(std::chrono::duration<double> duration);
+
+  bool isWorkerGovernorOn() const;
+  void setIsWorkerGovernorOn(bool isOn);
+
+  /*! Render buffers on a separate thread, one buffer ahead of the driver.
+   *
+   * The audio I/O callback only hands out the buffer rendered during the previous period
+   * and starts rendering the next one. The pipeline thread takes the place of the driver
+   * thread, e.g. when processing in the driver thread. Buffers of more than
+   * kMaxPipelinedBufferSize frames are truncated.
+   */
+  bool isPipelined() const;
+  void setIsPipelined(bool isPipelined);
+
+  CallbackTiming lastCallbackTiming() const;
+
+  /*! The wakeup of a worker thread (1 to numWorkerThreads()) for the current buffer.
+   *
+   * Only valid when called from the RenderEnded callback.
+   */
+  WorkerWakeup workerWakeup(int threadIndex) const;
+
+  /*! Pop the trace of the oldest buffer that hasn't been popped yet.
+   *
+   * Must only be called from a single thread. Buffers rendered while the queue is full,
+   * or by renderOffline(), aren't traced.
+   */
+  std::optional<RenderTrace> popRenderTrace();
+
+  /*! Render numFrames in buffers of preferredBufferSize() back to back, as fast as the
+   * worker threads allow.
+   *
+   * The calling thread takes the place of the audio I/O thread, and the driver doesn't
+   * invoke the callbacks in the meantime. Worker threads don't join the workgroup and the
+   * minimum load isn't applied. The output is discarded unless wavFilePath is given, in
+   * which case it's written there. Throws std::runtime_error if the file can't be
+   * created or written.
+   */
+  OfflineRenderStats renderOffline(int numFrames,
+                                   const std::optional<std::string>& wavFilePath = {});
+
 private:
   void whileStopped(const std::function<void()>& f);
 
   void setupDriver(Driver::Config config);
   void teardownDriver();
 
+  void setupProcessingThreads();
   void setupWorkerThreads();
   void teardownWorkerThreads();
 
+  void setupPipelineThread();
+  void teardownPipelineThread();
+
   void ensureMinimumLoad(std::chrono::time_point<Clock> bufferStartTime, int numFrames);
+  void updateWorkgroupMembership(
+    std::optional<SomeAudioWorkgroup::ScopedMembership>& membership);
 
   OSStatus render(AudioUnitRenderActionFlags* ioActionFlags,
                   const AudioTimeStamp* inTimeStamp,
                   UInt32 inBusNumber,
                   UInt32 inNumberFrames,
                   AudioBufferList* ioData);
+  ProcessingThreads renderBuffer(StereoAudioBufferPtrs ioBuffer,
+                                 uint64_t hostTime,
+                                 int numFrames);
+  void renderPipelined(StereoAudioBufferPtrs ioBuffer,
+                       uint64_t hostTime,
+                       int numFrames,
+                       Clock::time_point callbackStartTime);
 
-  void workerThread(int threadIndex);
+  static int numThreadsForEstimatedWork(const std::optional<WorkEstimate>& estimate,
+                                        int numProcessingThreads);
+  void wakeWorkerThreads(int numWorkerThreads);
+  void waitForWorkerThreads(int numWorkerThreads);
+  bool waitForWork(int threadIndex, uint64_t& round);
+  void finishWork();
+  void workerThread(int threadIndex, uint64_t round);
+  void pipelineThread();
 
   std::optional<Driver> mDriver;
   std::optional<SomeAudioWorkgroup> mAudioWorkgroup;
 
   std::atomic<bool> mProcessInDriverThread{
     kStandardPerformanceConfig.audioHost.processInDriverThread};
-  bool mIsWorkIntervalOn{kStandardPerformanceConfig.audioHost.isWorkIntervalOn};
+  std::atomic<bool> mIsWorkIntervalOn{
+    kStandardPerformanceConfig.audioHost.isWorkIntervalOn};
   std::atomic<int> mNumFrames{0};
 
+  struct alignas(kCacheLineSize) WorkerState
+  {
+    //! True if the worker is blocked, or about to block, on wakeupSemaphore
+    std::atomic<bool> isSleeping{false};
+    Semaphore wakeupSemaphore{0};
+    WorkerWakeup wakeup;
+    Clock::duration processDuration{};
+    ThreadTrace trace;
+  };
+
   std::atomic<bool> mAreWorkerThreadsActive{false};
   std::vector<std::thread> mWorkerThreads;
+  std::vector<WorkerState> mWorkerStates;
+  std::optional<ForkJoinBarrier> mForkJoinBarrier;
+  WorkerDispatch mWorkerDispatch{kStandardPerformanceConfig.audioHost.workerDispatch};
+
+  /*! A generation counter and the buffer's number of workers, packed into one word.
+   *
+   * Updated at the start of each buffer to signal spinning workers.
+   */
+  std::atomic<uint64_t> mWorkRound{0};
+  Clock::time_point mBufferStartTime;
+  Deadline mDeadline;
 
   std::atomic<double> mMinimumLoad{kStandardPerformanceConfig.audioHost.minimumLoad};
-  Semaphore mStartWorkingSemaphore{0};
+  std::atomic<double> mWorkerSpinDuration{
+    kStandardPerformanceConfig.audioHost.workerSpinDuration.count()};
   Semaphore mFinishedWorkSemaphore{0};
 
+  std::atomic<bool> mIsWorkerGovernorOn{
+    kStandardPerformanceConfig.audioHost.isWorkerGovernorOn};
+  //! Only used by the audio I/O thread
+  WorkerGovernor mWorkerGovernor;
+  bool mWasWorkerGovernorOn{false};
+
+  bool mIsPipelined{kStandardPerformanceConfig.audioHost.isPipelined};
+  std::thread mPipelineThread;
+  std::atomic<bool> mIsPipelineThreadActive{false};
+  Semaphore mPipelineRenderSemaphore{0};
+  Semaphore mPipelineDoneSemaphore{0};
+  //! The buffer being rendered by the pipeline thread and the one being delivered
+  std::array<StereoAudioBuffer, 2> mPipelineBuffers;
+  int mPipelineBufferIndex{0};
+  int mPipelineNumFrames{0};
+  uint64_t mPipelineHostTime{0};
+  Clock::time_point mPipelineRequestTime;
+  //! Only used by the audio I/O thread
+  bool mIsPipelineRendering{false};
+
+  std::atomic<double> mLastCallbackDuration{0.0};
+  std::atomic<double> mLastOutputLatency{0.0};
+
+  //! The trace of the current buffer, written by the thread rendering it
+  RenderTrace mRenderTrace;
+  FixedSPSCQueue<RenderTrace> mRenderTraces{kRenderTraceQueueSize};
+
   Setup mSetup;
   RenderStarted mRenderStarted;
   Process mProcess;
   RenderEnded mRenderEnded;
+  EstimateWork mEstimateWork;
+  BeginBuffer mBeginBuffer;
 
   bool mIsStarted{false};
-  int mNumProcessingThreads{-1};
+  bool mIsRenderingOffline{false};
+  std::atomic<int> mNumProcessingThreads{-1};
+  int mMaxNumProcessingThreads{0};
 };
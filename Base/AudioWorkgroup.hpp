@@ -24,9 +24,14 @@
 
 #include "Warnings.hpp"
 
-#include <os/workgroup.h>
 #include <variant>
 
+#if defined(__APPLE__)
+#include <os/workgroup.h>
+#endif
+
+#if defined(__APPLE__)
+
 /*! A safe C++ wrapper around the Audio Workgroup API.
  *
  * See https://developer.apple.com/documentation/audiotoolbox/workgroup_management
@@ -88,10 +93,14 @@ private:
   friend class AudioWorkgroup;
 };
 
+#endif
+
 /*! A wrapper around a private work interval API that can be used prior to iOS 14.
  *
  * Note: private APIs may stop working at any time and their use is forbidden in the App
  * Store. This class should not be used in production apps.
+ *
+ * On platforms other than Apple's there are no work intervals, so joining does nothing.
  */
 class LegacyAudioWorkgroup
 {
@@ -138,9 +147,14 @@ private:
 class SomeAudioWorkgroup
 {
 public:
+#if defined(__APPLE__)
   using WorkgroupVariant = std::variant<AudioWorkgroup, LegacyAudioWorkgroup>;
   using ScopedMembership = std::variant<AudioWorkgroup::ScopedMembership,
                                         LegacyAudioWorkgroup::ScopedMembership>;
+#else
+  using WorkgroupVariant = std::variant<LegacyAudioWorkgroup>;
+  using ScopedMembership = std::variant<LegacyAudioWorkgroup::ScopedMembership>;
+#endif
 
   explicit SomeAudioWorkgroup(const WorkgroupVariant& audioWorkgroup);
 
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "AudioWorkgroup.hpp"
+
+#include <thread>
+#include <utility>
+
+LegacyAudioWorkgroup::ScopedMembership::ScopedMembership()
+  : mIsActive{true}
+{
+}
+
+LegacyAudioWorkgroup::ScopedMembership::ScopedMembership(ScopedMembership&& other)
+  : mIsActive{std::exchange(other.mIsActive, false)}
+{
+}
+
+LegacyAudioWorkgroup::ScopedMembership& LegacyAudioWorkgroup::ScopedMembership::operator=(
+  ScopedMembership&& rhs)
+{
+  if (this != &rhs)
+  {
+    mIsActive = std::exchange(rhs.mIsActive, false);
+  }
+  return *this;
+}
+
+LegacyAudioWorkgroup::ScopedMembership::~ScopedMembership() = default;
+
+int LegacyAudioWorkgroup::maxNumParallelThreads() const
+{
+  // Like on Apple platforms, include hyperthreading cores
+  return int(std::thread::hardware_concurrency());
+}
+
+LegacyAudioWorkgroup::ScopedMembership LegacyAudioWorkgroup::join()
+{
+  return ScopedMembership{};
+}
+
+
+SomeAudioWorkgroup::SomeAudioWorkgroup(const WorkgroupVariant& workgroup)
+  : mWorkgroup{workgroup}
+{
+}
+
+int SomeAudioWorkgroup::maxNumParallelThreads() const
+{
+  return std::visit(
+    [](const auto& workgroup) { return workgroup.maxNumParallelThreads(); }, mWorkgroup);
+}
+
+SomeAudioWorkgroup::ScopedMembership SomeAudioWorkgroup::join()
+{
+  return std::visit(
+    [&](auto& workgroup) { return ScopedMembership{workgroup.join()}; }, mWorkgroup);
+}
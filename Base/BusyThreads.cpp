@@ -29,9 +29,14 @@
 #include <condition_variable>
 #include <mutex>
 #include <pthread.h>
-#include <pthread/sched.h>
 #include <thread>
 
+#if defined(__APPLE__)
+#include <pthread/sched.h>
+#else
+#include <sched.h>
+#endif
+
 class BusyThreadImpl
 {
 public:
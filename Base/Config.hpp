@@ -48,20 +48,47 @@ constexpr std::optional<int> kUseRecommendedNumThreads = std::nullopt;
 
 struct AudioHostConfig
 {
+  //! How the audio I/O thread starts worker threads and waits for them to finish
+  enum class WorkerDispatch
+  {
+    //! Post a semaphore per worker to start it and wait on a semaphore once per worker
+    semaphores,
+
+    //! Start all workers and wait for them with one ForkJoinBarrier
+    forkJoinBarrier,
+  };
+
   // Set to kUseRecommendedNumThreads to use the system's recommended number of threads
   std::optional<int> numProcessingThreads;
 
   bool processInDriverThread{};
   bool isWorkIntervalOn{};
   double minimumLoad{};
+
+  // How long idle worker threads spin before blocking until the next buffer. Spinning
+  // avoids the kernel's wakeup latency if the next buffer starts within this duration.
+  std::chrono::duration<double> workerSpinDuration{};
+
+  WorkerDispatch workerDispatch{};
+
+  // Adapt the number of processing threads woken per buffer to the recent load, up to
+  // numProcessingThreads. See WorkerGovernor.
+  bool isWorkerGovernorOn{};
+
+  // Render each buffer during the previous audio I/O callback's period on a separate
+  // thread. Adds one buffer of output latency, but gives processing threads a full
+  // period regardless of when the callback runs.
+  bool isPipelined{};
 };
 
 inline bool operator==(const AudioHostConfig& lhs, const AudioHostConfig& rhs)
 {
   return std::tie(lhs.numProcessingThreads, lhs.processInDriverThread,
-                  lhs.isWorkIntervalOn, lhs.minimumLoad)
+                  lhs.isWorkIntervalOn, lhs.minimumLoad, lhs.workerSpinDuration,
+                  lhs.workerDispatch, lhs.isWorkerGovernorOn, lhs.isPipelined)
          == std::tie(rhs.numProcessingThreads, rhs.processInDriverThread,
-                     rhs.isWorkIntervalOn, rhs.minimumLoad);
+                     rhs.isWorkIntervalOn, rhs.minimumLoad, rhs.workerSpinDuration,
+                     rhs.workerDispatch, rhs.isWorkerGovernorOn, rhs.isPipelined);
 }
 
 inline bool operator!=(const AudioHostConfig& lhs, const AudioHostConfig& rhs)
@@ -99,6 +126,10 @@ constexpr auto kStandardPerformanceConfig = PerformanceConfig{
     .processInDriverThread = true,
     .isWorkIntervalOn = true,
     .minimumLoad = 0.0,
+    .workerSpinDuration = std::chrono::seconds{0},
+    .workerDispatch = AudioHostConfig::WorkerDispatch::semaphores,
+    .isWorkerGovernorOn = false,
+    .isPipelined = false,
   },
 };
 
@@ -113,9 +144,16 @@ constexpr auto kOptimalPerformanceConfig = PerformanceConfig{
     .processInDriverThread = false,
     .isWorkIntervalOn = false,
     .minimumLoad = kStandardPerformanceConfig.audioHost.minimumLoad,
+    .workerSpinDuration = kStandardPerformanceConfig.audioHost.workerSpinDuration,
+    .workerDispatch = kStandardPerformanceConfig.audioHost.workerDispatch,
+    .isWorkerGovernorOn = kStandardPerformanceConfig.audioHost.isWorkerGovernorOn,
+    .isPipelined = kStandardPerformanceConfig.audioHost.isPipelined,
   },
 };
 
 constexpr auto kCacheLineSize = 128;
 constexpr auto kDefaultPreferredBufferSize = 128;
+constexpr auto kMaxPipelinedBufferSize = 4096;
+constexpr auto kMaxNumTracedThreads = 32;
+constexpr auto kRenderTraceQueueSize = 256;
 constexpr auto kRealtimeThreadQuantum = std::chrono::microseconds{500};
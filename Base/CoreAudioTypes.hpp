@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#if defined(__APPLE__)
+
+#include <AudioToolbox/AUComponent.h>
+#include <CoreAudio/CoreAudioTypes.h>
+
+#else
+
+#include <cstdint>
+
+// The subset of CoreAudio's types that Driver and AudioHost use in their interfaces, so
+// that they can be built with a SimulatedDevice on platforms without CoreAudio. The
+// layouts match CoreAudio's for the members that are declared.
+
+using OSStatus = int32_t;
+using UInt32 = uint32_t;
+using UInt64 = uint64_t;
+using Float64 = double;
+
+constexpr OSStatus noErr = 0;
+
+using AudioUnitRenderActionFlags = UInt32;
+
+enum : UInt32
+{
+  kAudioTimeStampSampleTimeValid = 1u << 0,
+  kAudioTimeStampHostTimeValid = 1u << 1,
+};
+
+struct AudioTimeStamp
+{
+  Float64 mSampleTime;
+  UInt64 mHostTime;
+  Float64 mRateScalar;
+  UInt64 mWordClockTime;
+  UInt32 mFlags;
+};
+
+struct AudioBuffer
+{
+  UInt32 mNumberChannels;
+  UInt32 mDataByteSize;
+  void* mData;
+};
+
+//! Like CoreAudio's, mBuffers is variable-length and has mNumberBuffers elements
+struct AudioBufferList
+{
+  UInt32 mNumberBuffers;
+  AudioBuffer mBuffers[1];
+};
+
+#endif
+
+//! An AudioBufferList with room for the two buffers of non-interleaved stereo audio
+struct StereoAudioBufferList
+{
+  AudioBufferList list;
+  AudioBuffer secondBuffer;
+};
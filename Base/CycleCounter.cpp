@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CycleCounter.hpp"
+
+#include <thread>
+
+namespace
+{
+
+double measureCycleCounterFrequency()
+{
+#if defined(__arm64__) || defined(__aarch64__)
+  uint64_t frequency;
+  __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+  return double(frequency);
+#else
+  // The time stamp counter runs at a constant rate on all CPUs this runs on, but the rate
+  // isn't exposed, so count ticks over a short interval of the steady clock.
+  using Clock = std::chrono::steady_clock;
+  constexpr auto kCalibrationDuration = std::chrono::milliseconds{10};
+
+  const auto startTime = Clock::now();
+  const auto startTicks = readCycleCounter();
+  std::this_thread::sleep_for(kCalibrationDuration);
+  const auto endTime = Clock::now();
+  const auto endTicks = readCycleCounter();
+  return double(endTicks - startTicks)
+         / std::chrono::duration<double>{endTime - startTime}.count();
+#endif
+}
+
+} // namespace
+
+double cycleCounterFrequency()
+{
+  static const auto frequency = measureCycleCounterFrequency();
+  return frequency;
+}
+
+std::chrono::duration<double> cycleCounterTicksToSeconds(const uint64_t ticks)
+{
+  return std::chrono::duration<double>{double(ticks) / cycleCounterFrequency()};
+}
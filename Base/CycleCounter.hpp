@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*! Read a monotonic hardware counter.
+ *
+ * Much cheaper than reading std::chrono clocks, so it can be used to timestamp every
+ * stage of every buffer. Reads the ARM generic timer's virtual count or the x86 time
+ * stamp counter. Convert differences to seconds with cycleCounterTicksToSeconds().
+ */
+inline uint64_t readCycleCounter()
+{
+#if defined(__arm64__) || defined(__aarch64__)
+  uint64_t ticks;
+  __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(ticks) : : "memory");
+  return ticks;
+#elif defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+#error readCycleCounter() not implemented on this architecture
+#endif
+}
+
+/*! The number of ticks of readCycleCounter() per second.
+ *
+ * Read from the generic timer's frequency register on ARM. On x86 it's calibrated against
+ * std::chrono::steady_clock the first time it's called, which takes a few milliseconds,
+ * so call it once before using the counter on the audio thread.
+ */
+double cycleCounterFrequency();
+
+std::chrono::duration<double> cycleCounterTicksToSeconds(uint64_t ticks);
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+
+/*! The time by which processing threads should have finished rendering a buffer.
+ *
+ * Passed to the Process callback so that threads can check between units of work
+ * whether the buffer is about to overrun and skip work that isn't essential. A
+ * default-constructed deadline never expires.
+ */
+class Deadline
+{
+public:
+  using Clock = std::chrono::high_resolution_clock;
+
+  Deadline() = default;
+  explicit Deadline(const Clock::time_point time)
+    : mTime{time}
+  {
+  }
+
+  Clock::time_point time() const { return mTime; }
+
+private:
+  Clock::time_point mTime{Clock::time_point::max()};
+};
@@ -24,16 +24,26 @@
 
 #include "AudioWorkgroup.hpp"
 #include "Config.hpp"
+#include "CoreAudioTypes.hpp"
 #include "FixedSPSCQueue.hpp"
 #include "VolumeFader.hpp"
 
-#include <AudioToolbox/AUComponent.h>
-#include <CoreAudio/CoreAudioTypes.h>
+#if !defined(__APPLE__)
+#include "SimulatedDevice.hpp"
+#endif
+
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <mutex>
 #include <optional>
 
+/*! The audio driver, which invokes a render callback for every buffer.
+ *
+ * On Apple platforms it uses AURemoteIO. Elsewhere there is no audio device, so a
+ * SimulatedDevice invokes the render callback and the output is discarded.
+ */
 class Driver
 {
 public:
@@ -51,6 +61,10 @@ public:
     int preferredBufferSize = kDefaultPreferredBufferSize;
     bool isInputEnabled = false;
     float outputVolume = 1.0;
+
+#if !defined(__APPLE__)
+    SimulatedDevice::Config simulatedDevice{};
+#endif
   };
 
   using RenderCallback = std::function<OSStatus(AudioUnitRenderActionFlags* ioActionFlags,
@@ -76,6 +90,14 @@ public:
 
   bool isInputEnabled() const;
 
+  /*! The number of render callbacks that missed their deadline since the driver was
+   * created.
+   *
+   * Missed deadlines are detected as jumps in the sample time, since the device skips
+   * ahead after a dropout.
+   */
+  uint64_t numMissedDeadlines() const;
+
   //! The volume of the output is an amplitude and must be >= 0
   float outputVolume() const;
   void setOutputVolume(float volume, Seconds fadeDuration);
@@ -84,8 +106,10 @@ public:
    *
    * If an error occurs, std::nullopt is returned and a message is logged.
    */
+#if defined(__APPLE__)
   API_AVAILABLE(ios(14.0))
   std::optional<AudioWorkgroup> workgroup() const;
+#endif
 
 private:
   struct FadeCommand
@@ -101,11 +125,15 @@ private:
 
   void requestBufferSize(int requestedBufferSize);
 
+#if defined(__APPLE__)
   void setupAudioSession();
   void teardownAudioSession();
 
   void setupIoUnit();
   void teardownIoUnit();
+#else
+  void setupSimulatedDevice(int bufferSize);
+#endif
 
   OSStatus render(AudioUnitRenderActionFlags* ioActionFlags,
                   const AudioTimeStamp* inTimeStamp,
@@ -113,7 +141,11 @@ private:
                   UInt32 inNumberFrames,
                   AudioBufferList* ioData);
 
+#if defined(__APPLE__)
   AudioUnit mpRemoteIoUnit{};
+#else
+  std::optional<SimulatedDevice> mSimulatedDevice;
+#endif
   FixedSPSCQueue<FadeCommand> mCommandQueue;
 
   Config mConfig;
@@ -123,6 +155,9 @@ private:
 
   VolumeFader<float> mVolumeFader;
 
+  std::optional<Float64> mNextSampleTime;
+  std::atomic<uint64_t> mNumMissedDeadlines{0};
+
   RenderCallback mRenderCallback;
   std::mutex mRenderMutex;
   std::unique_lock<std::mutex> mRenderLock;
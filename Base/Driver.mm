@@ -167,6 +167,8 @@ void Driver::setPreferredBufferSize(const int preferredBufferSize)
 
 bool Driver::isInputEnabled() const { return mConfig.isInputEnabled; }
 
+uint64_t Driver::numMissedDeadlines() const { return mNumMissedDeadlines; }
+
 float Driver::outputVolume() const { return mConfig.outputVolume; }
 void Driver::setOutputVolume(const float volume, const Seconds fadeDuration)
 {
@@ -345,6 +347,15 @@ OSStatus Driver::render(AudioUnitRenderActionFlags* ioActionFlags,
     mCommandQueue.popFront();
   }
 
+  if (inTimeStamp->mFlags & kAudioTimeStampSampleTimeValid)
+  {
+    if (mNextSampleTime && inTimeStamp->mSampleTime != *mNextSampleTime)
+    {
+      ++mNumMissedDeadlines;
+    }
+    mNextSampleTime = inTimeStamp->mSampleTime + inNumberFrames;
+  }
+
   const AudioBuffer* pIoBuffers = ioData->mBuffers;
   const StereoAudioBufferPtrs ioBuffer{
     static_cast<float*>(pIoBuffers[0].mData), static_cast<float*>(pIoBuffers[1].mData)};
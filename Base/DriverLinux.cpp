@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Base/Driver.hpp"
+
+#include "Assert.hpp"
+#include "AudioBuffer.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+constexpr auto kCommandQueueSize = 16;
+
+} // anonymous namespace
+
+Driver::Driver(Driver::RenderCallback renderCallback, const Config config)
+  : mCommandQueue{kCommandQueueSize}
+  , mConfig{config}
+  , mVolumeFader{config.outputVolume}
+  , mRenderCallback{[callback = std::move(renderCallback), this](const auto... xs) {
+    std::unique_lock<std::mutex> lock(mRenderMutex, std::try_to_lock);
+    if (lock.owns_lock())
+    {
+      return callback(xs...);
+    }
+
+    return OSStatus(noErr);
+  }}
+  , mRenderLock{mRenderMutex}
+{
+  mSampleRate = mConfig.simulatedDevice.sampleRate;
+  setupSimulatedDevice(mConfig.preferredBufferSize);
+  BASE_LOG("Sample Rate: %.0f", mSampleRate);
+}
+
+Driver::~Driver() { mSimulatedDevice = std::nullopt; }
+
+void Driver::start()
+{
+  if (mStatus == Status::kStopped)
+  {
+    mRenderLock = {};
+    mStatus = Status::kStarted;
+  }
+}
+
+void Driver::stop()
+{
+  if (mStatus == Status::kStarted)
+  {
+    mRenderLock = std::unique_lock<std::mutex>{mRenderMutex};
+    mStatus = Status::kStopped;
+  }
+}
+
+Driver::Status Driver::status() const { return mStatus; }
+Driver::Config Driver::config() const { return mConfig; }
+
+double Driver::sampleRate() const { return mSampleRate; }
+Driver::Seconds Driver::nominalBufferDuration() const { return mNominalBufferDuration; }
+
+int Driver::preferredBufferSize() const { return mConfig.preferredBufferSize; }
+void Driver::setPreferredBufferSize(const int preferredBufferSize)
+{
+  if (preferredBufferSize != mConfig.preferredBufferSize)
+  {
+    requestBufferSize(preferredBufferSize);
+    mConfig.preferredBufferSize = preferredBufferSize;
+  }
+}
+
+bool Driver::isInputEnabled() const { return mConfig.isInputEnabled; }
+
+uint64_t Driver::numMissedDeadlines() const { return mNumMissedDeadlines; }
+
+float Driver::outputVolume() const { return mConfig.outputVolume; }
+void Driver::setOutputVolume(const float volume, const Seconds fadeDuration)
+{
+  assertRelease(volume >= 0.0f, "invalid volume");
+
+  const auto fadeDurationInFrames = uint64_t(fadeDuration.count() * mSampleRate);
+  mCommandQueue.tryPushBack(FadeCommand{volume, fadeDurationInFrames});
+  mConfig.outputVolume = volume;
+}
+
+void Driver::requestBufferSize(const int requestedBufferSize)
+{
+  // The device runs continuously like AURemoteIO, so restart it with the new size
+  mSimulatedDevice = std::nullopt;
+  mNextSampleTime = std::nullopt;
+  setupSimulatedDevice(requestedBufferSize);
+}
+
+void Driver::setupSimulatedDevice(const int bufferSize)
+{
+  mSimulatedDevice.emplace([this](const auto... xs) { return this->render(xs...); },
+                           mConfig.simulatedDevice, bufferSize);
+  mNominalBufferDuration = mSimulatedDevice->nominalBufferDuration();
+}
+
+OSStatus Driver::render(AudioUnitRenderActionFlags* ioActionFlags,
+                        const AudioTimeStamp* inTimeStamp,
+                        const UInt32 inBusNumber,
+                        const UInt32 inNumberFrames,
+                        AudioBufferList* ioData)
+{
+  while (const auto* pCommand = mCommandQueue.front())
+  {
+    (*pCommand)(*this);
+    mCommandQueue.popFront();
+  }
+
+  if (inTimeStamp->mFlags & kAudioTimeStampSampleTimeValid)
+  {
+    if (mNextSampleTime && inTimeStamp->mSampleTime != *mNextSampleTime)
+    {
+      ++mNumMissedDeadlines;
+    }
+    mNextSampleTime = inTimeStamp->mSampleTime + inNumberFrames;
+  }
+
+  // There is no input, so the input is silence when it's enabled
+  const AudioBuffer* pIoBuffers = ioData->mBuffers;
+  const StereoAudioBufferPtrs ioBuffer{
+    static_cast<float*>(pIoBuffers[0].mData), static_cast<float*>(pIoBuffers[1].mData)};
+  std::fill_n(ioBuffer[0], inNumberFrames, 0.0f);
+  std::fill_n(ioBuffer[1], inNumberFrames, 0.0f);
+
+  const auto result =
+    mRenderCallback(ioActionFlags, inTimeStamp, inBusNumber, inNumberFrames, ioData);
+  mVolumeFader.process(ioBuffer, inNumberFrames);
+  return result;
+}
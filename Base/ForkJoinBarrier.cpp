@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ForkJoinBarrier.hpp"
+
+#include "Assert.hpp"
+#include "Thread.hpp"
+
+#if defined(__APPLE__)
+#include <cstdint>
+#else
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Atomics must be usable as wait addresses");
+
+#if defined(__APPLE__)
+
+// The ulock API used by libc++ to implement std::atomic::wait() on Apple platforms
+extern "C" int __ulock_wait(uint32_t operation, void* pAddress, uint64_t value,
+                            uint32_t timeoutMicroseconds);
+extern "C" int __ulock_wake(uint32_t operation, void* pAddress, uint64_t wakeValue);
+
+constexpr uint32_t kUlockCompareAndWait = 1;
+constexpr uint32_t kUlockWakeAll = 0x00000100;
+constexpr uint32_t kUlockNoErrno = 0x01000000;
+
+void waitOnAddress(std::atomic<uint32_t>& address, const uint32_t value)
+{
+  __ulock_wait(kUlockCompareAndWait | kUlockNoErrno, &address, value, 0);
+}
+
+void wakeOne(std::atomic<uint32_t>& address)
+{
+  __ulock_wake(kUlockCompareAndWait | kUlockNoErrno, &address, 0);
+}
+
+void wakeAll(std::atomic<uint32_t>& address)
+{
+  __ulock_wake(kUlockCompareAndWait | kUlockWakeAll | kUlockNoErrno, &address, 0);
+}
+
+#else
+
+void waitOnAddress(std::atomic<uint32_t>& address, const uint32_t value)
+{
+  syscall(SYS_futex, &address, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+}
+
+void wakeOne(std::atomic<uint32_t>& address)
+{
+  syscall(SYS_futex, &address, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void wakeAll(std::atomic<uint32_t>& address)
+{
+  syscall(SYS_futex, &address, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#endif
+
+constexpr uint32_t kNumWorkersBits = 16;
+constexpr uint32_t kNumWorkersMask = (1u << kNumWorkersBits) - 1;
+
+uint32_t numWorkersInRound(const uint32_t round) { return round & kNumWorkersMask; }
+
+uint32_t nextRound(const uint32_t round, const uint32_t numWorkers)
+{
+  return (((round >> kNumWorkersBits) + 1) << kNumWorkersBits) | numWorkers;
+}
+
+} // namespace
+
+ForkJoinBarrier::ForkJoinBarrier(const int maxNumWorkers)
+  : mMaxNumWorkers{uint32_t(maxNumWorkers)}
+{
+  assertRelease(maxNumWorkers >= 0 && uint32_t(maxNumWorkers) <= kNumWorkersMask,
+                "Invalid number of workers");
+}
+
+uint32_t ForkJoinBarrier::round() const { return mRound; }
+
+void ForkJoinBarrier::fork(const int numWorkers)
+{
+  assertRelease(numWorkers >= 0 && uint32_t(numWorkers) <= mMaxNumWorkers,
+                "Invalid number of workers");
+
+  // Workers only read the number of pending workers after seeing the new round
+  const auto previousRound = mRound.load(std::memory_order_relaxed);
+  mNumPendingWorkers.store(uint32_t(numWorkers), std::memory_order_relaxed);
+  mRound = nextRound(previousRound, uint32_t(numWorkers));
+
+  // A worker that increments mNumBlockedWorkers after this load will see the new
+  // round when the kernel compares it, so it won't block.
+  if (mNumBlockedWorkers > 0)
+  {
+    wakeAll(mRound);
+  }
+
+  // Workers only park after seeing a round they're not part of. Parked workers can only
+  // be needed if this round has more workers than the previous one, since every
+  // increase unparks all of them.
+  if (uint32_t(numWorkers) > numWorkersInRound(previousRound))
+  {
+    mUnparkGeneration.fetch_add(1);
+    if (mNumParkedWorkers > 0)
+    {
+      wakeAll(mUnparkGeneration);
+    }
+  }
+}
+
+void ForkJoinBarrier::join()
+{
+  uint32_t numPendingWorkers;
+  while ((numPendingWorkers = mNumPendingWorkers.load(std::memory_order_acquire)) != 0)
+  {
+    mIsCoordinatorBlocked = true;
+    waitOnAddress(mNumPendingWorkers, numPendingWorkers);
+    mIsCoordinatorBlocked = false;
+  }
+}
+
+bool ForkJoinBarrier::waitForFork(const int workerIndex,
+                                  uint32_t& round,
+                                  const std::chrono::duration<double> spinDuration)
+{
+  using Clock = std::chrono::high_resolution_clock;
+
+  auto wasSpinning = true;
+  while (true)
+  {
+    const auto spinEndTime =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(spinDuration);
+    while (mRound.load(std::memory_order_acquire) == round)
+    {
+      if (Clock::now() >= spinEndTime)
+      {
+        ++mNumBlockedWorkers;
+        while (mRound.load(std::memory_order_acquire) == round)
+        {
+          waitOnAddress(mRound, round);
+        }
+        --mNumBlockedWorkers;
+        wasSpinning = false;
+        break;
+      }
+
+      hardwareDelay();
+    }
+
+    round = mRound.load(std::memory_order_acquire);
+    if (uint32_t(workerIndex) <= numWorkersInRound(round))
+    {
+      return wasSpinning;
+    }
+
+    // Park until a round needs this worker. Announce parking before checking the round
+    // one last time, so that either this thread sees the next round or fork() sees the
+    // parked worker. The unpark generation is loaded first so that an unpark in between
+    // makes the wait return immediately.
+    const auto unparkGeneration = mUnparkGeneration.load();
+    ++mNumParkedWorkers;
+    if (mRound == round)
+    {
+      waitOnAddress(mUnparkGeneration, unparkGeneration);
+    }
+    --mNumParkedWorkers;
+    wasSpinning = false;
+  }
+}
+
+void ForkJoinBarrier::arrive()
+{
+  // The coordinator announces that it's blocking before the kernel compares the number
+  // of pending workers, so either it sees zero or this thread sees the flag.
+  if (mNumPendingWorkers.fetch_sub(1, std::memory_order_acq_rel) == 1
+      && mIsCoordinatorBlocked)
+  {
+    wakeOne(mNumPendingWorkers);
+  }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "Config.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*! A barrier for repeatedly forking work to a pool of worker threads and joining
+ * them again.
+ *
+ * The coordinating thread calls fork() to start a round and join() to wait until every
+ * participating worker has called arrive(). Workers wait for the next round with
+ * waitForFork(). Waiting threads block on the address of a counter (a futex on Linux, a
+ * ulock on Apple platforms), so each round costs at most one system call to wake all
+ * workers and one to wake the coordinator, regardless of the number of workers.
+ *
+ * Each round can use a different number of workers. Workers that aren't part of a round
+ * park on a separate address, so that they aren't woken again until a round needs them.
+ */
+class ForkJoinBarrier
+{
+public:
+  explicit ForkJoinBarrier(int maxNumWorkers);
+
+  ForkJoinBarrier(const ForkJoinBarrier&) = delete;
+  ForkJoinBarrier& operator=(const ForkJoinBarrier&) = delete;
+
+  //! The current round. Workers pass it to waitForFork() to wait for the next round.
+  uint32_t round() const;
+
+  /*! Start a new round with workers 1 to numWorkers, waking them. Must not be called
+   * before join() returned.
+   */
+  void fork(int numWorkers);
+
+  //! Wait until all workers of the current round have arrived
+  void join();
+
+  /*! Wait until a round after round has started that includes workerIndex (1-based).
+   *
+   * Updates round to the round that started. Spin for up to spinDuration before
+   * blocking. Returns true if the round started while spinning.
+   */
+  bool waitForFork(int workerIndex,
+                   uint32_t& round,
+                   std::chrono::duration<double> spinDuration);
+
+  //! Signal that the calling worker has finished its work for the current round
+  void arrive();
+
+private:
+  const uint32_t mMaxNumWorkers;
+
+  //! A generation counter and the round's number of workers, packed into one word
+  alignas(kCacheLineSize) std::atomic<uint32_t> mRound{0};
+  std::atomic<uint32_t> mNumBlockedWorkers{0};
+
+  alignas(kCacheLineSize) std::atomic<uint32_t> mUnparkGeneration{0};
+  std::atomic<uint32_t> mNumParkedWorkers{0};
+
+  alignas(kCacheLineSize) std::atomic<uint32_t> mNumPendingWorkers{0};
+  std::atomic<bool> mIsCoordinatorBlocked{false};
+};
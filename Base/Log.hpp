@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/*! Log to the system log: os_log on Apple platforms and syslog elsewhere.
+ *
+ * The format must be a string literal, as required by os_log.
+ */
+#if defined(__APPLE__)
+#include <os/log.h>
+#define BASE_LOG(...) os_log(OS_LOG_DEFAULT, __VA_ARGS__)
+#define BASE_LOG_ERROR(...) os_log_error(OS_LOG_DEFAULT, __VA_ARGS__)
+#else
+#include <syslog.h>
+#define BASE_LOG(...) syslog(LOG_INFO, __VA_ARGS__)
+#define BASE_LOG_ERROR(...) syslog(LOG_ERR, __VA_ARGS__)
+#endif
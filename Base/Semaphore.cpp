@@ -23,13 +23,30 @@
 #include "Base/Semaphore.hpp"
 
 #include <cstdint>
+#include <stdexcept>
+
+#if defined(__APPLE__)
 #include <mach/mach_init.h>
 #include <mach/semaphore.h>
 #include <mach/sync_policy.h>
 #include <mach/task.h>
-#include <stdexcept>
+#else
+#include <cerrno>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
-#if defined(__has_feature) && __has_feature(thread_sanitizer)
+// GCC doesn't provide __has_feature, but defines __SANITIZE_THREAD__ instead
+#if defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define IS_THREAD_SANITIZER_ON 1
+#endif
+#elif defined(__SANITIZE_THREAD__)
+#define IS_THREAD_SANITIZER_ON 1
+#endif
+
+#if defined(IS_THREAD_SANITIZER_ON)
 #define ANNOTATE_HAPPENS_BEFORE(addr)                                                    \
   AnnotateHappensBefore(__FILE__, __LINE__, static_cast<void*>(addr))
 #define ANNOTATE_HAPPENS_AFTER(addr)                                                     \
@@ -41,6 +58,8 @@ extern "C" void AnnotateHappensAfter(const char* f, int l, void* addr);
 #define ANNOTATE_HAPPENS_AFTER(addr)
 #endif
 
+#if defined(__APPLE__)
+
 Semaphore::Semaphore(const uint32_t initial)
 {
   if (semaphore_create(mach_task_self(), &mSemaphore, SYNC_POLICY_FIFO, int(initial)))
@@ -65,7 +84,7 @@ Semaphore::Status Semaphore::wait()
     result = semaphore_wait(mSemaphore);
   } while (result == KERN_ABORTED);
 
-#if defined(__has_feature) && __has_feature(thread_sanitizer)
+#if defined(IS_THREAD_SANITIZER_ON)
   if (result == KERN_SUCCESS)
   {
     ANNOTATE_HAPPENS_AFTER(&mSemaphore);
@@ -74,3 +93,64 @@ Semaphore::Status Semaphore::wait()
 
   return result == KERN_SUCCESS ? Status::success : Status::error;
 }
+
+#else
+
+Semaphore::Semaphore(const uint32_t initial)
+  : mCount{initial}
+{
+}
+
+Semaphore::~Semaphore() = default;
+
+Semaphore::Status Semaphore::post()
+{
+  ANNOTATE_HAPPENS_BEFORE(&mCount);
+
+  // Waiters register before checking the count for the last time, so either they see
+  // the increment or this thread sees them.
+  mCount.fetch_add(1);
+  if (mNumWaiters > 0
+      && syscall(SYS_futex, &mCount, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0) < 0)
+  {
+    return Status::error;
+  }
+
+  return Status::success;
+}
+
+Semaphore::Status Semaphore::wait()
+{
+  const auto tryDecrement = [this] {
+    auto count = mCount.load();
+    while (count > 0)
+    {
+      if (mCount.compare_exchange_weak(count, count - 1))
+      {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  if (!tryDecrement())
+  {
+    ++mNumWaiters;
+    while (!tryDecrement())
+    {
+      // Blocks only if the count is still zero
+      if (syscall(SYS_futex, &mCount, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0) < 0
+          && errno != EAGAIN && errno != EINTR)
+      {
+        --mNumWaiters;
+        return Status::error;
+      }
+    }
+    --mNumWaiters;
+  }
+
+  ANNOTATE_HAPPENS_AFTER(&mCount);
+  return Status::success;
+}
+
+#endif
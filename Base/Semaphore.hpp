@@ -23,7 +23,12 @@
 #pragma once
 
 #include <cstdint>
+
+#if defined(__APPLE__)
 #include <mach/mach_types.h>
+#else
+#include <atomic>
+#endif
 
 /*! A system-provided counting semaphore.
  *
@@ -43,6 +48,10 @@
  * can then wait on that semaphore before reading an event from the queue.  If P writes 8
  * items, then it will increment the semaphore 8 times, so C will "wake up" 8 times, even
  * if C is not waiting on the semaphore at the time P posts to it.
+ *
+ * On Apple platforms this is a Mach semaphore. Elsewhere, it is an atomic count with a
+ * futex to block on, so post() and wait() only enter the kernel when a thread actually
+ * needs to block or be woken up.
  */
 class Semaphore
 {
@@ -73,5 +82,10 @@ public:
   Status wait();
 
 private:
+#if defined(__APPLE__)
   semaphore_t mSemaphore;
+#else
+  std::atomic<uint32_t> mCount;
+  std::atomic<uint32_t> mNumWaiters{0};
+#endif
 };
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cmath>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*! A vector of floats that maps onto the widest SIMD register available at compile time.
+ *
+ * NEON (arm64) and SSE2 use four lanes and AVX2 uses eight. Other architectures fall back
+ * to a single scalar lane so that kernels written against FloatVector stay portable.
+ */
+struct FloatVector
+{
+#if defined(__aarch64__)
+  using Native = float32x4_t;
+  static constexpr int kSize = 4;
+#elif defined(__AVX2__)
+  using Native = __m256;
+  static constexpr int kSize = 8;
+#elif defined(__SSE2__)
+  using Native = __m128;
+  static constexpr int kSize = 4;
+#else
+  using Native = float;
+  static constexpr int kSize = 1;
+#endif
+
+  Native value;
+};
+
+//! The alignment required by loadAligned() and storeAligned()
+constexpr auto kSimdAlignment = 32;
+
+inline FloatVector broadcast(const float x)
+{
+#if defined(__aarch64__)
+  return {vdupq_n_f32(x)};
+#elif defined(__AVX2__)
+  return {_mm256_set1_ps(x)};
+#elif defined(__SSE2__)
+  return {_mm_set1_ps(x)};
+#else
+  return {x};
+#endif
+}
+
+inline FloatVector loadAligned(const float* pSource)
+{
+#if defined(__aarch64__)
+  return {vld1q_f32(pSource)};
+#elif defined(__AVX2__)
+  return {_mm256_load_ps(pSource)};
+#elif defined(__SSE2__)
+  return {_mm_load_ps(pSource)};
+#else
+  return {*pSource};
+#endif
+}
+
+inline void storeAligned(float* pDest, const FloatVector x)
+{
+#if defined(__aarch64__)
+  vst1q_f32(pDest, x.value);
+#elif defined(__AVX2__)
+  _mm256_store_ps(pDest, x.value);
+#elif defined(__SSE2__)
+  _mm_store_ps(pDest, x.value);
+#else
+  *pDest = x.value;
+#endif
+}
+
+inline FloatVector load(const float* pSource)
+{
+#if defined(__aarch64__)
+  return {vld1q_f32(pSource)};
+#elif defined(__AVX2__)
+  return {_mm256_loadu_ps(pSource)};
+#elif defined(__SSE2__)
+  return {_mm_loadu_ps(pSource)};
+#else
+  return {*pSource};
+#endif
+}
+
+inline void store(float* pDest, const FloatVector x)
+{
+#if defined(__aarch64__)
+  vst1q_f32(pDest, x.value);
+#elif defined(__AVX2__)
+  _mm256_storeu_ps(pDest, x.value);
+#elif defined(__SSE2__)
+  _mm_storeu_ps(pDest, x.value);
+#else
+  *pDest = x.value;
+#endif
+}
+
+inline FloatVector operator+(const FloatVector a, const FloatVector b)
+{
+#if defined(__aarch64__)
+  return {vaddq_f32(a.value, b.value)};
+#elif defined(__AVX2__)
+  return {_mm256_add_ps(a.value, b.value)};
+#elif defined(__SSE2__)
+  return {_mm_add_ps(a.value, b.value)};
+#else
+  return {a.value + b.value};
+#endif
+}
+
+inline FloatVector operator-(const FloatVector a, const FloatVector b)
+{
+#if defined(__aarch64__)
+  return {vsubq_f32(a.value, b.value)};
+#elif defined(__AVX2__)
+  return {_mm256_sub_ps(a.value, b.value)};
+#elif defined(__SSE2__)
+  return {_mm_sub_ps(a.value, b.value)};
+#else
+  return {a.value - b.value};
+#endif
+}
+
+inline FloatVector operator*(const FloatVector a, const FloatVector b)
+{
+#if defined(__aarch64__)
+  return {vmulq_f32(a.value, b.value)};
+#elif defined(__AVX2__)
+  return {_mm256_mul_ps(a.value, b.value)};
+#elif defined(__SSE2__)
+  return {_mm_mul_ps(a.value, b.value)};
+#else
+  return {a.value * b.value};
+#endif
+}
+
+inline FloatVector abs(const FloatVector x)
+{
+#if defined(__aarch64__)
+  return {vabsq_f32(x.value)};
+#elif defined(__AVX2__)
+  return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.value)};
+#elif defined(__SSE2__)
+  return {_mm_andnot_ps(_mm_set1_ps(-0.0f), x.value)};
+#else
+  return {std::fabs(x.value)};
+#endif
+}
+
+//! Return the magnitude of `magnitude` with the sign of `sign`
+inline FloatVector copySign(const FloatVector magnitude, const FloatVector sign)
+{
+#if defined(__aarch64__)
+  const auto signMask = vdupq_n_u32(0x80000000);
+  return {vbslq_f32(signMask, sign.value, magnitude.value)};
+#elif defined(__AVX2__)
+  const auto signMask = _mm256_set1_ps(-0.0f);
+  return {_mm256_or_ps(_mm256_and_ps(signMask, sign.value),
+                       _mm256_andnot_ps(signMask, magnitude.value))};
+#elif defined(__SSE2__)
+  const auto signMask = _mm_set1_ps(-0.0f);
+  return {_mm_or_ps(_mm_and_ps(signMask, sign.value),
+                    _mm_andnot_ps(signMask, magnitude.value))};
+#else
+  return {std::copysign(magnitude.value, sign.value)};
+#endif
+}
+
+//! Return `value` in lanes where `a >= b` and zero in all other lanes
+inline FloatVector valueIfGreaterEqual(const FloatVector a,
+                                       const FloatVector b,
+                                       const FloatVector value)
+{
+#if defined(__aarch64__)
+  return {vreinterpretq_f32_u32(
+    vandq_u32(vcgeq_f32(a.value, b.value), vreinterpretq_u32_f32(value.value)))};
+#elif defined(__AVX2__)
+  return {_mm256_and_ps(_mm256_cmp_ps(a.value, b.value, _CMP_GE_OQ), value.value)};
+#elif defined(__SSE2__)
+  return {_mm_and_ps(_mm_cmpge_ps(a.value, b.value), value.value)};
+#else
+  return {a.value >= b.value ? value.value : 0.0f};
+#endif
+}
+
+//! The sum of all lanes
+inline float horizontalSum(const FloatVector x)
+{
+#if defined(__aarch64__)
+  return vaddvq_f32(x.value);
+#elif defined(__AVX2__)
+  const auto pairs =
+    _mm_add_ps(_mm256_castps256_ps128(x.value), _mm256_extractf128_ps(x.value, 1));
+  const auto quads = _mm_add_ps(pairs, _mm_movehl_ps(pairs, pairs));
+  return _mm_cvtss_f32(_mm_add_ss(quads, _mm_shuffle_ps(quads, quads, 1)));
+#elif defined(__SSE2__)
+  const auto pairs = _mm_add_ps(x.value, _mm_movehl_ps(x.value, x.value));
+  return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+#else
+  return x.value;
+#endif
+}
+
+/*! A polynomial approximation of sin(x) for x in [-pi, pi].
+ *
+ * The argument is folded into [-pi/2, pi/2] and evaluated with an 11th order Taylor
+ * polynomial. The maximum absolute error is below 1e-6, which is well below the noise
+ * floor of the single precision oscillators that use it.
+ */
+inline FloatVector sinApprox(const FloatVector x)
+{
+  const auto halfPi = broadcast(float(M_PI_2));
+
+  // sin(x) == sign(x) * sin(pi/2 - |pi/2 - |x||) for x in [-pi, pi]
+  const auto folded = halfPi - abs(halfPi - abs(x));
+  const auto x2 = folded * folded;
+
+  auto result = broadcast(-1.0f / 39916800.0f);
+  result = result * x2 + broadcast(1.0f / 362880.0f);
+  result = result * x2 + broadcast(-1.0f / 5040.0f);
+  result = result * x2 + broadcast(1.0f / 120.0f);
+  result = result * x2 + broadcast(-1.0f / 6.0f);
+  result = result * x2 + broadcast(1.0f);
+  return copySign(result * folded, x);
+}
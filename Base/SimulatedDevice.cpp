@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SimulatedDevice.hpp"
+
+#include "Assert.hpp"
+#include "Config.hpp"
+#include "Log.hpp"
+#include "Thread.hpp"
+
+#include <cstdint>
+#include <random>
+#include <system_error>
+
+SimulatedDevice::SimulatedDevice(RenderCallback renderCallback,
+                                 const Config config,
+                                 const int bufferSize)
+  : mRenderCallback{std::move(renderCallback)}
+  , mConfig{config}
+  , mBufferSize{bufferSize}
+  , mLeftBuffer(size_t(bufferSize))
+  , mRightBuffer(size_t(bufferSize))
+{
+  assertRelease(config.sampleRate > 0.0, "Invalid sample rate");
+  assertRelease(config.jitter.count() >= 0.0, "Invalid jitter");
+  assertRelease(bufferSize > 0, "Invalid buffer size");
+
+  const auto numBytes = UInt32(size_t(bufferSize) * sizeof(float));
+  mBufferList.list.mNumberBuffers = 2;
+  mBufferList.list.mBuffers[0] = AudioBuffer{1, numBytes, mLeftBuffer.data()};
+  mBufferList.secondBuffer = AudioBuffer{1, numBytes, mRightBuffer.data()};
+
+  mThread = std::thread{&SimulatedDevice::deviceThread, this};
+}
+
+SimulatedDevice::~SimulatedDevice()
+{
+  mIsRunning = false;
+  mThread.join();
+}
+
+const SimulatedDevice::Config& SimulatedDevice::config() const { return mConfig; }
+int SimulatedDevice::bufferSize() const { return mBufferSize; }
+
+SimulatedDevice::Seconds SimulatedDevice::nominalBufferDuration() const
+{
+  return Seconds{mBufferSize / mConfig.sampleRate};
+}
+
+void SimulatedDevice::deviceThread()
+{
+  using Clock = std::chrono::steady_clock;
+
+  setCurrentThreadName("Simulated Audio Device");
+  const auto bufferDuration = nominalBufferDuration();
+  try
+  {
+    setThreadTimeConstraintPolicy(
+      pthread_self(),
+      TimeConstraintPolicy{bufferDuration, kRealtimeThreadQuantum, bufferDuration});
+  }
+  catch (const std::system_error& error)
+  {
+    // Keep running without real-time guarantees, e.g., when lacking the privileges
+    BASE_LOG_ERROR("Simulated device thread isn't real-time: %s", error.what());
+  }
+
+  const auto period = std::chrono::duration_cast<Clock::duration>(bufferDuration);
+  std::minstd_rand randomEngine{std::random_device{}()};
+  std::uniform_real_distribution<double> jitterDistribution{0.0, mConfig.jitter.count()};
+
+  double sampleTime = 0.0;
+  auto nominalStartTime = Clock::now();
+  while (mIsRunning)
+  {
+    std::this_thread::sleep_until(
+      nominalStartTime
+      + std::chrono::duration_cast<Clock::duration>(
+        Seconds{jitterDistribution(randomEngine)}));
+
+    AudioTimeStamp timeStamp{};
+    timeStamp.mSampleTime = sampleTime;
+    timeStamp.mHostTime = currentMachAbsoluteTime();
+    timeStamp.mRateScalar = 1.0;
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid | kAudioTimeStampHostTimeValid;
+
+    AudioUnitRenderActionFlags actionFlags{};
+    mRenderCallback(&actionFlags, &timeStamp, 0, UInt32(mBufferSize), &mBufferList.list);
+
+    // A buffer that isn't done by the next nominal start time is a dropout. Like
+    // hardware, resume at the next period boundary, skipping the periods that passed.
+    const auto deadline = nominalStartTime + period;
+    const auto endTime = Clock::now();
+    int64_t numPeriods = 1;
+    if (endTime > deadline)
+    {
+      numPeriods += (endTime - deadline) / period + 1;
+    }
+    nominalStartTime += numPeriods * period;
+    sampleTime += double(numPeriods * mBufferSize);
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "CoreAudioTypes.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/*! A stand-in for an audio device that invokes a render callback from a real-time timer
+ * thread at the nominal buffer period.
+ *
+ * Each callback may start up to a random jitter after its nominal start time and must
+ * finish before the next nominal start time. If it doesn't, the device behaves like
+ * hardware that played silence: it resumes at the next period boundary and the sample
+ * time skips the missed periods. The output is discarded.
+ */
+class SimulatedDevice
+{
+public:
+  using Seconds = std::chrono::duration<double>;
+
+  struct Config
+  {
+    double sampleRate = 48000.0;
+
+    //! The maximum delay of a callback after its nominal start time
+    Seconds jitter{};
+  };
+
+  using RenderCallback = std::function<OSStatus(AudioUnitRenderActionFlags* ioActionFlags,
+                                                const AudioTimeStamp* inTimeStamp,
+                                                UInt32 inBusNumber,
+                                                UInt32 inNumberFrames,
+                                                AudioBufferList* ioData)>;
+
+  //! Start invoking renderCallback with bufferSize frames per buffer
+  SimulatedDevice(RenderCallback renderCallback, Config config, int bufferSize);
+  ~SimulatedDevice();
+
+  SimulatedDevice(const SimulatedDevice&) = delete;
+  SimulatedDevice& operator=(const SimulatedDevice&) = delete;
+
+  const Config& config() const;
+  int bufferSize() const;
+  Seconds nominalBufferDuration() const;
+
+private:
+  void deviceThread();
+
+  RenderCallback mRenderCallback;
+  Config mConfig;
+  int mBufferSize;
+
+  std::vector<float> mLeftBuffer;
+  std::vector<float> mRightBuffer;
+  StereoAudioBufferList mBufferList{};
+
+  std::atomic<bool> mIsRunning{true};
+  std::thread mThread;
+};
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TaskGraph.hpp"
+
+#include "Assert.hpp"
+#include "Math.hpp"
+#include "Thread.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+void TaskGraph::clear()
+{
+  mTasks.clear();
+  mDependencies.clear();
+  mIsCompiled = false;
+}
+
+TaskGraph::TaskId TaskGraph::addTask(Task task)
+{
+  mTasks.push_back(std::move(task));
+  mIsCompiled = false;
+  return TaskId(mTasks.size() - 1);
+}
+
+void TaskGraph::addDependency(const TaskId predecessor, const TaskId task)
+{
+  assertRelease(predecessor >= 0 && predecessor < numTasks() && task >= 0
+                  && task < numTasks() && predecessor != task,
+                "Invalid dependency");
+
+  mDependencies.emplace_back(predecessor, task);
+  mIsCompiled = false;
+}
+
+void TaskGraph::compile()
+{
+  const auto n = numTasks();
+
+  // Store the successors of all tasks contiguously, grouped by task
+  mSuccessorOffsets.assign(n + 1, 0);
+  mNumPredecessors.assign(n, 0);
+  for (const auto& [predecessor, task] : mDependencies)
+  {
+    ++mSuccessorOffsets[predecessor + 1];
+    ++mNumPredecessors[task];
+  }
+  for (int i = 0; i < n; ++i)
+  {
+    mSuccessorOffsets[i + 1] += mSuccessorOffsets[i];
+  }
+  mSuccessors.resize(mDependencies.size());
+  auto nextSuccessorIndices = mSuccessorOffsets;
+  for (const auto& [predecessor, task] : mDependencies)
+  {
+    mSuccessors[nextSuccessorIndices[predecessor]++] = task;
+  }
+
+  // Check for cycles by visiting tasks in topological order
+  auto numPendingPredecessors = mNumPredecessors;
+  std::vector<TaskId> readyTasks;
+  for (TaskId task = 0; task < n; ++task)
+  {
+    if (numPendingPredecessors[task] == 0)
+    {
+      readyTasks.push_back(task);
+    }
+  }
+  for (size_t i = 0; i < readyTasks.size(); ++i)
+  {
+    const auto task = readyTasks[i];
+    for (int j = mSuccessorOffsets[task]; j < mSuccessorOffsets[task + 1]; ++j)
+    {
+      if (--numPendingPredecessors[mSuccessors[j]] == 0)
+      {
+        readyTasks.push_back(mSuccessors[j]);
+      }
+    }
+  }
+  assertRelease(int(readyTasks.size()) == n, "Task graph contains a cycle");
+
+  mTopologicalOrder = std::move(readyTasks);
+  mRootTasks.clear();
+  for (TaskId task = 0; task < n; ++task)
+  {
+    if (mNumPredecessors[task] == 0)
+    {
+      mRootTasks.push_back(task);
+    }
+  }
+  mTaskCosts.assign(n, 0.0);
+  mPathCosts.assign(n, 0.0);
+  mTasksByRank.resize(n);
+  mTaskRanks.resize(n);
+
+  mNumPendingPredecessors = std::vector<std::atomic<int>>(n);
+  mReadyStates = std::vector<std::atomic<ReadyState>>(n);
+  mIsCompiled = true;
+}
+
+int TaskGraph::numTasks() const { return int(mTasks.size()); }
+
+void TaskGraph::prepare()
+{
+  assertRelease(mIsCompiled, "The task graph must be compiled before executing it");
+
+  mNumReadyTasks = 0;
+  mNumFinishedTasks = 0;
+  for (auto& readyState : mReadyStates)
+  {
+    readyState.store(ReadyState::waiting, std::memory_order_relaxed);
+  }
+  for (TaskId task = 0; task < numTasks(); ++task)
+  {
+    mNumPendingPredecessors[task].store(
+      mNumPredecessors[task], std::memory_order_relaxed);
+  }
+
+  prioritizeCriticalPath();
+  for (const auto task : mRootTasks)
+  {
+    pushReadyTask(task);
+  }
+}
+
+void TaskGraph::process(const int threadIndex)
+{
+  const auto n = numTasks();
+  while (mNumFinishedTasks.load(std::memory_order_acquire) < n)
+  {
+    if (const auto task = popReadyTask())
+    {
+      // The weight of the last buffer in the cost average
+      constexpr auto kSmoothingCoeff = 0.25;
+
+      const auto startTime = Clock::now();
+      mTasks[*task](threadIndex);
+      const auto cost = std::chrono::duration<double>{Clock::now() - startTime}.count();
+      auto& averageCost = mTaskCosts[*task];
+      averageCost = averageCost > 0.0 ? lerp(averageCost, cost, kSmoothingCoeff) : cost;
+
+      finishTask(*task);
+    }
+    else
+    {
+      hardwareDelay();
+    }
+  }
+}
+
+void TaskGraph::prioritizeCriticalPath()
+{
+  // Visit successors before their predecessors
+  for (auto it = mTopologicalOrder.rbegin(); it != mTopologicalOrder.rend(); ++it)
+  {
+    const auto task = *it;
+    double maxSuccessorPathCost = 0.0;
+    for (int i = mSuccessorOffsets[task]; i < mSuccessorOffsets[task + 1]; ++i)
+    {
+      maxSuccessorPathCost = std::max(maxSuccessorPathCost, mPathCosts[mSuccessors[i]]);
+    }
+    mPathCosts[task] = mTaskCosts[task] + maxSuccessorPathCost;
+  }
+
+  // Break ties by task ID so that unmeasured graphs keep the order of addTask()
+  std::iota(mTasksByRank.begin(), mTasksByRank.end(), 0);
+  std::sort(mTasksByRank.begin(), mTasksByRank.end(),
+            [&](const TaskId a, const TaskId b) {
+              return mPathCosts[a] != mPathCosts[b] ? mPathCosts[a] > mPathCosts[b]
+                                                    : a < b;
+            });
+  for (int rank = 0; rank < numTasks(); ++rank)
+  {
+    mTaskRanks[mTasksByRank[rank]] = rank;
+  }
+}
+
+void TaskGraph::pushReadyTask(const TaskId task)
+{
+  // Publish the task before counting it, so that a thread that sees the count finds it.
+  // A thread may take the task before it's counted, making the count briefly negative.
+  mReadyStates[mTaskRanks[task]].store(ReadyState::ready, std::memory_order_release);
+  mNumReadyTasks.fetch_add(1, std::memory_order_release);
+}
+
+std::optional<TaskGraph::TaskId> TaskGraph::popReadyTask()
+{
+  if (mNumReadyTasks.load(std::memory_order_acquire) <= 0)
+  {
+    return std::nullopt;
+  }
+
+  for (int rank = 0; rank < numTasks(); ++rank)
+  {
+    auto& readyState = mReadyStates[rank];
+    auto expectedState = ReadyState::ready;
+    if (readyState.load(std::memory_order_relaxed) == ReadyState::ready
+        && readyState.compare_exchange_strong(
+          expectedState, ReadyState::taken, std::memory_order_acquire))
+    {
+      mNumReadyTasks.fetch_sub(1, std::memory_order_relaxed);
+      return mTasksByRank[rank];
+    }
+  }
+
+  return std::nullopt;
+}
+
+void TaskGraph::finishTask(const TaskId task)
+{
+  for (int i = mSuccessorOffsets[task]; i < mSuccessorOffsets[task + 1]; ++i)
+  {
+    const auto successor = mSuccessors[i];
+    if (mNumPendingPredecessors[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      pushReadyTask(successor);
+    }
+  }
+  mNumFinishedTasks.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "Config.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/*! Executes a graph of tasks with dependencies on a set of threads, once per buffer.
+ *
+ * Build the graph with addTask() and addDependency() and call compile() once. Then, for
+ * every buffer, call prepare() before the threads start and process() from each of
+ * them. Threads take tasks from a lock-free set of ready tasks, and finishing a task
+ * makes each successor ready whose predecessors have all finished. prepare() and
+ * process() don't allocate.
+ *
+ * Tasks on the critical path are started first. The time of each task is measured, and
+ * prepare() ranks all tasks by the longest chain of measured times from the task to the
+ * end of the graph. Threads always take the highest-ranked task among those ready,
+ * regardless of when it became ready. Finding it scans the ranks, which is cheap for
+ * graphs of up to a few hundred tasks.
+ */
+class TaskGraph
+{
+  using Clock = std::chrono::high_resolution_clock;
+
+public:
+  using Task = std::function<void(int threadIndex)>;
+  using TaskId = int;
+
+  //! Remove all tasks and dependencies
+  void clear();
+
+  TaskId addTask(Task task);
+
+  //! Don't start task before predecessor has finished
+  void addDependency(TaskId predecessor, TaskId task);
+
+  //! Prepare the graph for execution. The dependencies must not contain cycles.
+  void compile();
+
+  int numTasks() const;
+
+  //! Reset the graph for the next buffer. Must be called while no thread processes it.
+  void prepare();
+
+  /*! Run ready tasks until all tasks of the graph have finished.
+   *
+   * Threads spin while the remaining tasks wait for their predecessors, so every thread
+   * returns at about the same time.
+   */
+  void process(int threadIndex);
+
+private:
+  //! The state of a task in the ready set
+  enum class ReadyState : uint8_t
+  {
+    waiting,
+    ready,
+    taken,
+  };
+
+  void prioritizeCriticalPath();
+  void pushReadyTask(TaskId task);
+  std::optional<TaskId> popReadyTask();
+  void finishTask(TaskId task);
+
+  std::vector<Task> mTasks;
+  std::vector<std::pair<TaskId, TaskId>> mDependencies;
+  bool mIsCompiled{false};
+
+  //! The successors of task i are mSuccessors[mSuccessorOffsets[i]...[i + 1]]
+  std::vector<int> mSuccessorOffsets;
+  std::vector<TaskId> mSuccessors;
+  std::vector<int> mNumPredecessors;
+  std::vector<TaskId> mTopologicalOrder;
+  //! The tasks without predecessors, which are ready at the start of each buffer
+  std::vector<TaskId> mRootTasks;
+
+  //! The recent time of each task in seconds, only written by the thread running it
+  std::vector<double> mTaskCosts;
+  //! The longest sum of task costs from each task to the end of the graph
+  std::vector<double> mPathCosts;
+  //! All tasks by decreasing path cost, and the position of each task in that order
+  std::vector<TaskId> mTasksByRank;
+  std::vector<int> mTaskRanks;
+
+  std::vector<std::atomic<int>> mNumPendingPredecessors;
+
+  //! Indexed by rank. Each task becomes ready exactly once per buffer.
+  std::vector<std::atomic<ReadyState>> mReadyStates;
+  //! The number of tasks that are ready and not taken, or about to be
+  alignas(kCacheLineSize) std::atomic<int> mNumReadyTasks{0};
+  alignas(kCacheLineSize) std::atomic<int> mNumFinishedTasks{0};
+};
@@ -22,6 +22,11 @@
 
 #include "Thread.hpp"
 
+#include "Log.hpp"
+
+#include <system_error>
+
+#if defined(__APPLE__)
 #include <mach/mach.h>
 #include <mach/mach_init.h>
 #include <mach/mach_time.h>
@@ -29,7 +34,15 @@
 #include <mach/thread_policy.h>
 #include <os/log.h>
 #include <sys/sysctl.h>
-#include <system_error>
+#else
+#include <ctime>
+#include <fstream>
+#include <set>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__APPLE__)
 
 namespace
 {
@@ -48,6 +61,8 @@ const mach_timebase_info_data_t sMachTimebaseInfo = [] {
 
 } // namespace
 
+uint64_t currentMachAbsoluteTime() { return mach_absolute_time(); }
+
 uint64_t secondsToMachAbsoluteTime(const std::chrono::duration<double> duration)
 {
   const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
@@ -112,3 +127,145 @@ void setThreadTimeConstraintPolicy(const pthread_t thread,
       std::error_code(result, std::system_category()), mach_error_string(result));
   }
 }
+
+#else
+
+namespace
+{
+
+// See TASK_COMM_LEN in the Linux sources. Includes the null terminating byte.
+constexpr auto kMaxThreadNameSize = 16;
+
+// Not defined by older C library headers. See sched_setattr(2).
+constexpr uint32_t kSchedDeadline = 6;
+constexpr uint64_t kSchedFlagResetOnFork = 0x01;
+constexpr uint64_t kSchedFlagReclaim = 0x02;
+
+struct SchedAttr
+{
+  uint32_t size;
+  uint32_t schedPolicy;
+  uint64_t schedFlags;
+  int32_t schedNice;
+  uint32_t schedPriority;
+  uint64_t schedRuntime;
+  uint64_t schedDeadline;
+  uint64_t schedPeriod;
+};
+
+// Above threaded interrupt handlers, which run at priority 50 by default
+constexpr int kFifoPriority = 80;
+
+/* The fraction of the constraint reserved as SCHED_DEADLINE runtime.
+ *
+ * Unlike the Mach quantum, the runtime is a hard budget: a thread that exhausts it is
+ * throttled until its next period. Audio threads may compute for most of the constraint,
+ * so reserve nearly all of it. The remainder keeps the bandwidth of a thread per CPU
+ * below the admission limit of 95% (see sched_rt_runtime_us).
+ */
+constexpr auto kDeadlineRuntimeFraction = 0.9;
+
+uint64_t toNanoseconds(const std::chrono::duration<double> duration)
+{
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+} // namespace
+
+uint64_t currentMachAbsoluteTime()
+{
+  timespec time{};
+  clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+  return uint64_t(time.tv_sec) * 1000000000 + uint64_t(time.tv_nsec);
+}
+
+uint64_t secondsToMachAbsoluteTime(const std::chrono::duration<double> duration)
+{
+  return toNanoseconds(duration);
+}
+
+std::chrono::duration<double> machAbsoluteTimeToSeconds(const uint64_t machAbsoluteTime)
+{
+  return std::chrono::nanoseconds{machAbsoluteTime};
+}
+
+std::string currentThreadName()
+{
+  char str[kMaxThreadNameSize] = {};
+  const auto result = pthread_getname_np(pthread_self(), str, kMaxThreadNameSize);
+  return result == 0 ? str : "";
+}
+
+void setCurrentThreadName(const std::string& name)
+{
+  // pthread_setname_np() fails if the name is too long, so truncate it to be at most
+  // kMaxThreadNameSize characters long, including the null terminating byte.
+  const std::string truncatedName{name, 0, kMaxThreadNameSize - 1};
+
+  pthread_setname_np(pthread_self(), truncatedName.c_str());
+}
+
+std::optional<int32_t> numPhysicalCpus()
+{
+  // Hyperthreads of the same core share a sibling list, so count the distinct lists
+  std::set<std::string> coreSiblingLists;
+  const auto numCpus = sysconf(_SC_NPROCESSORS_CONF);
+  for (long cpu = 0; cpu < numCpus; ++cpu)
+  {
+    std::ifstream file{"/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+                       + "/topology/thread_siblings_list"};
+    std::string siblingList;
+    if (std::getline(file, siblingList))
+    {
+      coreSiblingLists.insert(siblingList);
+    }
+  }
+
+  return !coreSiblingLists.empty()
+           ? std::optional<int32_t>{int32_t(coreSiblingLists.size())}
+           : std::nullopt;
+}
+
+void setThreadTimeConstraintPolicy(const pthread_t thread,
+                                   const TimeConstraintPolicy& timeConstraintPolicy)
+{
+  // sched_setattr() needs a thread ID, which is only available for the calling thread
+  if (pthread_equal(thread, pthread_self()))
+  {
+    SchedAttr attributes{};
+    attributes.size = sizeof(SchedAttr);
+    attributes.schedPolicy = kSchedDeadline;
+    // Deadline threads may only create threads if those don't inherit the policy
+    attributes.schedFlags = kSchedFlagResetOnFork | kSchedFlagReclaim;
+    attributes.schedRuntime =
+      toNanoseconds(timeConstraintPolicy.constraint * kDeadlineRuntimeFraction);
+    attributes.schedDeadline = toNanoseconds(timeConstraintPolicy.constraint);
+    attributes.schedPeriod = toNanoseconds(timeConstraintPolicy.period);
+
+    if (syscall(SYS_sched_setattr, 0, &attributes, 0) == 0)
+    {
+      BASE_LOG("Set deadline policy for %s: "
+               "(period: %llu, runtime: %llu, deadline: %llu)",
+               currentThreadName().c_str(),
+               static_cast<unsigned long long>(attributes.schedPeriod),
+               static_cast<unsigned long long>(attributes.schedRuntime),
+               static_cast<unsigned long long>(attributes.schedDeadline));
+      return;
+    }
+  }
+
+  // Admission control rejects deadline threads that would overcommit the CPUs, so fall
+  // back to a fixed real-time priority
+  sched_param param{};
+  param.sched_priority = kFifoPriority;
+  if (const auto result = pthread_setschedparam(thread, SCHED_FIFO, &param))
+  {
+    throw std::system_error(std::error_code(result, std::system_category()),
+                            "Could not set a real-time scheduling policy");
+  }
+
+  BASE_LOG("Set FIFO policy for %s: (priority: %d)", currentThreadName().c_str(),
+           param.sched_priority);
+}
+
+#endif
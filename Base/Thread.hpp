@@ -23,14 +23,21 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <optional>
 #include <pthread.h>
 #include <string>
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
 #if defined(__SSE__)
 #include <emmintrin.h>
 #endif
 
+// On Linux, CLOCK_MONOTONIC_RAW in nanoseconds takes the place of mach absolute time
+uint64_t currentMachAbsoluteTime();
 uint64_t secondsToMachAbsoluteTime(std::chrono::duration<double> duration);
 std::chrono::duration<double> machAbsoluteTimeToSeconds(uint64_t machTime);
 
@@ -47,6 +54,18 @@ struct TimeConstraintPolicy
   std::chrono::duration<double> constraint{};
 };
 
+/*! Make a thread real-time with the given timing constraints.
+ *
+ * On Apple platforms, the fields map to the Mach time constraint policy, with quantum as
+ * its computation.
+ *
+ * On Linux, the calling thread uses SCHED_DEADLINE with a period of period and a deadline
+ * of constraint. The runtime is a hard budget there, so it's derived from constraint
+ * rather than from quantum, which has no equivalent and is ignored. Other threads, or
+ * when the kernel rejects the deadline parameters, use SCHED_FIFO instead.
+ *
+ * Throws std::system_error on failure.
+ */
 void setThreadTimeConstraintPolicy(pthread_t thread,
                                    const TimeConstraintPolicy& timeConstraintPolicy);
 
@@ -62,6 +81,8 @@ inline void hardwareDelay()
   // 1.32us. XNU's implementation of machine_delay_until() also depends on this event
   // stream.
   __builtin_arm_wfe();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
 #elif defined(__arm__)
   __builtin_arm_yield();
 #elif defined(__SSE__)
@@ -98,7 +119,11 @@ void lowEnergyWorkUntil(const std::chrono::time_point<Clock, Rep> until)
 // _os_cpu_number() from XNU with support for both older and newer macOS/iOS versions
 inline unsigned int cpuNumber()
 {
-#if defined(__arm64__)
+#if defined(__linux__)
+  // glibc reads the CPU number from the thread's rseq area if it's registered, and falls
+  // back to the vDSO getcpu() otherwise, so this doesn't enter the kernel either way.
+  return static_cast<unsigned int>(sched_getcpu());
+#elif defined(__arm64__)
   // The TSD base and CPU number are stored in TPIDR_EL0 instead of TPIDRRO_EL0 on macOS
   // 12 and up and iOS 15 and up. Prior to these versions TPIDR_EL0 is always zero, so we
   // use TPIDR_EL0 if it's set and fallback to TPIDRRO_EL0 if not.
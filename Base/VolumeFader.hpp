@@ -43,6 +43,8 @@ public:
     mRampedValue.rampTo(amp, numFrames);
   }
 
+  bool isFading() const { return mRampedValue.isRamping(); }
+
   void process(const StereoAudioBufferPtrs ioBuffer, const uint64_t numFrames)
   {
     if (mRampedValue.isRamping() || mRampedValue.value() != T(1))
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "WavFileWriter.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr uint16_t kFormatIeeeFloat = 3;
+constexpr uint16_t kNumChannels = 2;
+constexpr uint16_t kBytesPerSample = sizeof(float);
+constexpr uint32_t kHeaderSize = 58;
+
+void writeLittleEndian(std::ofstream& file, const uint32_t value, const int numBytes)
+{
+  for (int i = 0; i < numBytes; ++i)
+  {
+    file.put(char((value >> (8 * i)) & 0xff));
+  }
+}
+
+} // namespace
+
+WavFileWriter::WavFileWriter(const std::string& path, const double sampleRate)
+  : mPath{path}
+  , mFile{path, std::ios::binary | std::ios::trunc}
+  , mSampleRate{uint32_t(std::lround(sampleRate))}
+{
+  if (!mFile)
+  {
+    throw std::runtime_error("Couldn't open " + path + " for writing");
+  }
+
+  writeHeader();
+}
+
+WavFileWriter::~WavFileWriter()
+{
+  if (mFile.is_open())
+  {
+    mFile.seekp(0);
+    writeHeader();
+  }
+}
+
+void WavFileWriter::write(const StereoAudioBufferPtrs buffer, const int numFrames)
+{
+  mInterleavedBuffer.resize(size_t(numFrames) * kNumChannels);
+  for (int i = 0; i < numFrames; ++i)
+  {
+    mInterleavedBuffer[size_t(i) * kNumChannels] = buffer[0][i];
+    mInterleavedBuffer[size_t(i) * kNumChannels + 1] = buffer[1][i];
+  }
+
+  // Samples are little-endian in WAV files, like on all of our targets
+  mFile.write(reinterpret_cast<const char*>(mInterleavedBuffer.data()),
+              std::streamsize(mInterleavedBuffer.size() * kBytesPerSample));
+  mNumFrames += uint32_t(numFrames);
+}
+
+void WavFileWriter::close()
+{
+  mFile.seekp(0);
+  writeHeader();
+  mFile.close();
+
+  // The stream stays failed after the first failed write
+  if (!mFile)
+  {
+    throw std::runtime_error("Couldn't write to " + mPath);
+  }
+}
+
+void WavFileWriter::writeHeader()
+{
+  const uint32_t blockAlign = kNumChannels * kBytesPerSample;
+  const uint32_t dataSize = mNumFrames * blockAlign;
+
+  mFile.write("RIFF", 4);
+  writeLittleEndian(mFile, kHeaderSize - 8 + dataSize, 4);
+  mFile.write("WAVE", 4);
+
+  // Formats other than integer PCM need an extended fmt chunk and a fact chunk
+  mFile.write("fmt ", 4);
+  writeLittleEndian(mFile, 18, 4);
+  writeLittleEndian(mFile, kFormatIeeeFloat, 2);
+  writeLittleEndian(mFile, kNumChannels, 2);
+  writeLittleEndian(mFile, mSampleRate, 4);
+  writeLittleEndian(mFile, mSampleRate * blockAlign, 4);
+  writeLittleEndian(mFile, blockAlign, 2);
+  writeLittleEndian(mFile, kBytesPerSample * 8, 2);
+  writeLittleEndian(mFile, 0, 2);
+
+  mFile.write("fact", 4);
+  writeLittleEndian(mFile, 4, 4);
+  writeLittleEndian(mFile, mNumFrames, 4);
+
+  mFile.write("data", 4);
+  writeLittleEndian(mFile, dataSize, 4);
+}
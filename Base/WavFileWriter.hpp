@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "AudioBuffer.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*! Writes stereo audio to a 32-bit float WAV file.
+ *
+ * The sizes in the header are updated by close(), or when the writer is destroyed.
+ */
+class WavFileWriter
+{
+public:
+  //! Create or truncate the file at path. Throws std::runtime_error on failure.
+  WavFileWriter(const std::string& path, double sampleRate);
+  ~WavFileWriter();
+
+  WavFileWriter(const WavFileWriter&) = delete;
+  WavFileWriter& operator=(const WavFileWriter&) = delete;
+
+  /*! Append frames to the file.
+   *
+   * Doesn't throw, so it can be called while rendering. Failures are reported by close().
+   */
+  void write(StereoAudioBufferPtrs buffer, int numFrames);
+
+  //! Update the header and close the file. Throws std::runtime_error if any write failed.
+  void close();
+
+private:
+  void writeHeader();
+
+  std::string mPath;
+  std::ofstream mFile;
+  uint32_t mSampleRate;
+  uint32_t mNumFrames{0};
+  std::vector<float> mInterleavedBuffer;
+};
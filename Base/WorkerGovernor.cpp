@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "WorkerGovernor.hpp"
+
+#include "Assert.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+//! The fraction of the buffer duration each thread should spend processing
+constexpr auto kTargetThreadLoad = 0.5;
+
+//! A thread is only removed if the remaining ones stay below this fraction of the target
+constexpr auto kRemoveThreadMargin = 0.7;
+
+//! The number of consecutive light buffers before removing a thread
+constexpr auto kNumLightBuffersBeforeRemoving = 32;
+
+//! Rendering for longer than this fraction of the buffer duration uses all threads
+constexpr auto kBurstRenderLoad = 0.75;
+
+//! Work growing by more than this factor from one buffer to the next uses all threads
+constexpr auto kBurstWorkGrowth = 1.5;
+
+//! The factor by which the peak load decays per buffer
+constexpr auto kPeakLoadDecay = 0.95;
+
+} // namespace
+
+void WorkerGovernor::reset(const int maxNumThreads)
+{
+  assertRelease(maxNumThreads > 0, "Invalid number of threads");
+
+  mNumThreads = maxNumThreads;
+  mPeakLoad = 0.0;
+  mNumLightBuffers = 0;
+  mNumWorkUnits = -1;
+}
+
+void WorkerGovernor::anticipateWork(const int numWorkUnits, const int maxNumThreads)
+{
+  assertRelease(numWorkUnits >= 0, "Invalid amount of work");
+  assertRelease(maxNumThreads > 0, "Invalid number of threads");
+
+  // Like a burst detected by update(), but before rendering the buffer instead of after.
+  // update() then measures the load with all threads and falls back to the load rule.
+  if (mNumWorkUnits >= 0 && numWorkUnits > kBurstWorkGrowth * mNumWorkUnits)
+  {
+    mNumThreads = maxNumThreads;
+    mNumLightBuffers = 0;
+  }
+  mNumWorkUnits = numWorkUnits;
+}
+
+int WorkerGovernor::numThreads() const { return mNumThreads; }
+
+void WorkerGovernor::update(const std::chrono::duration<double> busyDuration,
+                            const std::chrono::duration<double> renderDuration,
+                            const std::chrono::duration<double> bufferDuration,
+                            const int maxNumThreads)
+{
+  assertRelease(maxNumThreads > 0, "Invalid number of threads");
+
+  const auto load = busyDuration / bufferDuration;
+  mNumThreads = std::min(mNumThreads, maxNumThreads);
+
+  // Bursts of work are handled with all threads right away. Waiting for the peak load to
+  // build up would risk missing deadlines in the meantime.
+  if (renderDuration / bufferDuration >= kBurstRenderLoad
+      || load >= kBurstRenderLoad * mNumThreads)
+  {
+    mNumThreads = maxNumThreads;
+    mPeakLoad = std::max(load, mPeakLoad);
+    mNumLightBuffers = 0;
+    return;
+  }
+
+  mPeakLoad = std::max(load, mPeakLoad * kPeakLoadDecay);
+
+  const auto numNeededThreads =
+    std::clamp(int(std::ceil(mPeakLoad / kTargetThreadLoad)), 1, maxNumThreads);
+  if (numNeededThreads > mNumThreads)
+  {
+    mNumThreads = numNeededThreads;
+    mNumLightBuffers = 0;
+  }
+  else if (mNumThreads > 1
+           && mPeakLoad < kRemoveThreadMargin * kTargetThreadLoad * (mNumThreads - 1))
+  {
+    if (++mNumLightBuffers >= kNumLightBuffersBeforeRemoving)
+    {
+      --mNumThreads;
+      mNumLightBuffers = 0;
+    }
+  }
+  else
+  {
+    mNumLightBuffers = 0;
+  }
+}
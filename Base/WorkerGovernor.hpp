@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+
+/*! Chooses how many processing threads render the next buffer from the load of recent
+ * buffers.
+ *
+ * The load of a buffer is the time all threads spent processing divided by the buffer
+ * duration, i.e. the number of threads that would be fully busy rendering it. The
+ * governor uses enough threads to keep each of them below a target load. It adds threads
+ * as soon as the load rises, but only removes one after the load stayed low enough for
+ * a number of buffers, so that it doesn't oscillate. If the threads came close to
+ * missing the deadline, all threads are used for the next buffer.
+ *
+ * The load of past buffers can't predict a sudden increase of the work, e.g. a burst of
+ * notes. If the host knows the work of the next buffer in advance, it passes it to
+ * anticipateWork(), and all threads are woken up front when the work jumps.
+ *
+ * Must only be used from the audio I/O thread.
+ */
+class WorkerGovernor
+{
+public:
+  //! Start over, using maxNumThreads threads
+  void reset(int maxNumThreads);
+
+  /*! Use all threads for the next buffer if its work jumped compared to the previous one.
+   *
+   * numWorkUnits is the estimated work of the next buffer in any unit, as long as it's
+   * proportional to the time it takes to render. Call before numThreads().
+   */
+  void anticipateWork(int numWorkUnits, int maxNumThreads);
+
+  //! The number of threads to use for the next buffer
+  int numThreads() const;
+
+  /*! Update the number of threads after rendering a buffer.
+   *
+   * busyDuration is the time all threads spent processing, renderDuration the time from
+   * waking the threads until all of them finished.
+   */
+  void update(std::chrono::duration<double> busyDuration,
+              std::chrono::duration<double> renderDuration,
+              std::chrono::duration<double> bufferDuration,
+              int maxNumThreads);
+
+private:
+  int mNumThreads{1};
+  double mPeakLoad{0.0};
+  int mNumLightBuffers{0};
+  //! The work passed to anticipateWork() for the previous buffer, or -1 if unknown
+  int mNumWorkUnits{-1};
+};
@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*! Stress tests for the lock-free primitives that audio threads synchronize with.
+ *
+ * Each test runs many rounds and changes the number of participating threads between
+ * rounds. A noise thread interrupts the participating threads with a signal at random
+ * times. The signal makes blocking futex calls return early, i.e. causes spurious
+ * wakeups, and its handler yields, which preempts the interrupted thread at an arbitrary
+ * point, e.g. between reserving and publishing a slot. Build with -fsanitize=thread to
+ * also check that the primitives order the data they hand over.
+ */
+
+#include "Base/ForkJoinBarrier.hpp"
+#include "Base/Semaphore.hpp"
+#include "Base/TaskGraph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <pthread.h>
+#include <random>
+#include <sched.h>
+#include <signal.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr auto kMaxNumThreads = 4;
+
+//! Interrupts registered threads with SIGUSR1 at random intervals while it exists
+class SignalNoise
+{
+public:
+  SignalNoise()
+  {
+    struct sigaction action
+    {
+    };
+    action.sa_handler = [](int) { sched_yield(); };
+    sigemptyset(&action.sa_mask);
+    // Without SA_RESTART, interrupted futex waits return EINTR
+    action.sa_flags = 0;
+    sigaction(SIGUSR1, &action, nullptr);
+
+    mThread = std::thread{[this] { run(); }};
+  }
+
+  ~SignalNoise()
+  {
+    mIsActive = false;
+    mThread.join();
+  }
+
+  SignalNoise(const SignalNoise&) = delete;
+  SignalNoise& operator=(const SignalNoise&) = delete;
+
+  //! Start interrupting the calling thread. It must call removeCurrentThread() to stop.
+  void addCurrentThread()
+  {
+    std::lock_guard<std::mutex> lock{mMutex};
+    mThreads.push_back(pthread_self());
+  }
+
+  void removeCurrentThread()
+  {
+    std::lock_guard<std::mutex> lock{mMutex};
+    mThreads.erase(std::find_if(mThreads.begin(), mThreads.end(), [](const auto thread) {
+      return pthread_equal(thread, pthread_self());
+    }));
+  }
+
+private:
+  void run()
+  {
+    std::minstd_rand random{1};
+    std::uniform_int_distribution<int> delayInMicroseconds{0, 200};
+    while (mIsActive)
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds{delayInMicroseconds(random)});
+
+      std::lock_guard<std::mutex> lock{mMutex};
+      if (!mThreads.empty())
+      {
+        pthread_kill(mThreads[random() % mThreads.size()], SIGUSR1);
+      }
+    }
+  }
+
+  std::atomic<bool> mIsActive{true};
+  std::mutex mMutex;
+  std::vector<pthread_t> mThreads;
+  std::thread mThread;
+};
+
+//! Registers the calling thread with a SignalNoise for the lifetime of the object
+class ScopedNoise
+{
+public:
+  explicit ScopedNoise(SignalNoise& noise)
+    : mNoise{noise}
+  {
+    mNoise.addCurrentThread();
+  }
+
+  ~ScopedNoise() { mNoise.removeCurrentThread(); }
+
+  ScopedNoise(const ScopedNoise&) = delete;
+  ScopedNoise& operator=(const ScopedNoise&) = delete;
+
+private:
+  SignalNoise& mNoise;
+};
+
+bool check(const bool condition, const char* pMessage)
+{
+  if (!condition)
+  {
+    std::fprintf(stderr, "FAIL: %s\n", pMessage);
+  }
+  return condition;
+}
+
+bool testForkJoinBarrier(SignalNoise& noise)
+{
+  constexpr auto kNumRounds = 20000;
+
+  ForkJoinBarrier barrier{kMaxNumThreads};
+  std::atomic<bool> isStopping{false};
+
+  // Written by the workers and read by the coordinator after join() without atomics, so
+  // that the thread sanitizer checks the ordering provided by the barrier.
+  std::vector<int> numRoundsPerWorker(kMaxNumThreads + 1, 0);
+
+  // Taken before starting the workers, so that none of them can miss the first round
+  const auto initialRound = barrier.round();
+  std::vector<std::thread> workers;
+  for (int workerIndex = 1; workerIndex <= kMaxNumThreads; ++workerIndex)
+  {
+    workers.emplace_back([&, workerIndex] {
+      ScopedNoise scopedNoise{noise};
+
+      // Alternate between blocking right away and spinning before blocking
+      const auto spinDuration = workerIndex % 2 == 0
+                                  ? std::chrono::duration<double>{0.0}
+                                  : std::chrono::duration<double>{20.0e-6};
+      auto round = initialRound;
+      while (true)
+      {
+        barrier.waitForFork(workerIndex, round, spinDuration);
+        if (isStopping)
+        {
+          barrier.arrive();
+          break;
+        }
+        ++numRoundsPerWorker[workerIndex];
+        barrier.arrive();
+      }
+    });
+  }
+
+  std::minstd_rand random{2};
+  auto expectedNumRoundsPerWorker = numRoundsPerWorker;
+  bool isPassed = true;
+  for (int roundIndex = 0; roundIndex < kNumRounds && isPassed; ++roundIndex)
+  {
+    const auto numWorkers = int(random() % (kMaxNumThreads + 1));
+    barrier.fork(numWorkers);
+    barrier.join();
+
+    for (int workerIndex = 1; workerIndex <= numWorkers; ++workerIndex)
+    {
+      ++expectedNumRoundsPerWorker[workerIndex];
+    }
+    isPassed = check(numRoundsPerWorker == expectedNumRoundsPerWorker,
+                     "Every worker of a round, and only those, must arrive once");
+  }
+
+  isStopping = true;
+  barrier.fork(kMaxNumThreads);
+  barrier.join();
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  return isPassed;
+}
+
+bool testSemaphoreHandoff(SignalNoise& noise)
+{
+  constexpr auto kNumHandoffs = 50000;
+
+  // Ping-pong a value that isn't atomic between two threads
+  Semaphore pingSemaphore{0};
+  Semaphore pongSemaphore{0};
+  int value = 0;
+
+  std::thread ponger{[&] {
+    ScopedNoise scopedNoise{noise};
+    for (int i = 0; i < kNumHandoffs; ++i)
+    {
+      pingSemaphore.wait();
+      ++value;
+      pongSemaphore.post();
+    }
+  }};
+
+  bool isPassed = true;
+  {
+    ScopedNoise scopedNoise{noise};
+    for (int i = 0; i < kNumHandoffs; ++i)
+    {
+      ++value;
+      pingSemaphore.post();
+      pongSemaphore.wait();
+    }
+    isPassed = check(value == 2 * kNumHandoffs, "Handoffs must not be lost");
+  }
+
+  ponger.join();
+  return isPassed;
+}
+
+bool testSemaphoreCounting(SignalNoise& noise)
+{
+  constexpr auto kNumRounds = 200;
+  constexpr auto kNumPostsPerProducer = 100;
+
+  Semaphore semaphore{0};
+  std::minstd_rand random{3};
+  for (int roundIndex = 0; roundIndex < kNumRounds; ++roundIndex)
+  {
+    // Every post must wake exactly one wait, whatever the number of threads
+    const auto numProducers = 1 + int(random() % kMaxNumThreads);
+    const auto numConsumers = 1 + int(random() % kMaxNumThreads);
+    const auto numPosts = numProducers * kNumPostsPerProducer;
+
+    std::atomic<int> numWaits{0};
+    std::vector<std::thread> threads;
+    for (int consumerIndex = 0; consumerIndex < numConsumers; ++consumerIndex)
+    {
+      threads.emplace_back([&] {
+        ScopedNoise scopedNoise{noise};
+        while (numWaits.fetch_add(1) < numPosts)
+        {
+          semaphore.wait();
+        }
+      });
+    }
+    for (int producerIndex = 0; producerIndex < numProducers; ++producerIndex)
+    {
+      threads.emplace_back([&] {
+        ScopedNoise scopedNoise{noise};
+        for (int i = 0; i < kNumPostsPerProducer; ++i)
+        {
+          semaphore.post();
+        }
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  // Each round consumed exactly what it posted, so a final post must be the only one left
+  semaphore.post();
+  semaphore.wait();
+  return true;
+}
+
+bool testTaskGraph(SignalNoise& noise)
+{
+  constexpr auto kNumTasks = 64;
+  constexpr auto kNumRounds = 1000;
+
+  TaskGraph graph;
+
+  // The depth of each task in the graph, computed by the task from its predecessors'
+  // results. The results aren't atomic, so the thread sanitizer checks that finishing a
+  // task happens before its successors start.
+  std::vector<std::vector<TaskGraph::TaskId>> predecessors(kNumTasks);
+  std::vector<int> depths(kNumTasks, 0);
+  std::vector<int> numRuns(kNumTasks, 0);
+  std::minstd_rand random{4};
+  for (TaskGraph::TaskId task = 0; task < kNumTasks; ++task)
+  {
+    graph.addTask([&, task](int) {
+      ++numRuns[task];
+      int depth = 0;
+      for (const auto predecessor : predecessors[task])
+      {
+        depth = std::max(depth, depths[predecessor] + 1);
+      }
+      depths[task] = depth;
+
+      // Give the other threads a chance to push and pop in the meantime
+      if (task % 3 == 0)
+      {
+        std::this_thread::yield();
+      }
+    });
+
+    // A few random predecessors among the earlier tasks
+    const auto numPredecessors = task == 0 ? 0 : int(random() % 4);
+    for (int i = 0; i < numPredecessors; ++i)
+    {
+      const auto predecessor = TaskGraph::TaskId(random() % task);
+      if (std::find(predecessors[task].begin(), predecessors[task].end(), predecessor)
+          == predecessors[task].end())
+      {
+        predecessors[task].push_back(predecessor);
+        graph.addDependency(predecessor, task);
+      }
+    }
+  }
+  graph.compile();
+
+  std::vector<int> expectedDepths(kNumTasks, 0);
+  for (TaskGraph::TaskId task = 0; task < kNumTasks; ++task)
+  {
+    for (const auto predecessor : predecessors[task])
+    {
+      expectedDepths[task] =
+        std::max(expectedDepths[task], expectedDepths[predecessor] + 1);
+    }
+  }
+
+  bool isPassed = true;
+  for (int roundIndex = 0; roundIndex < kNumRounds && isPassed; ++roundIndex)
+  {
+    std::fill(depths.begin(), depths.end(), -1);
+    std::fill(numRuns.begin(), numRuns.end(), 0);
+    graph.prepare();
+
+    const auto numThreads = 1 + int(random() % kMaxNumThreads);
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+    {
+      threads.emplace_back([&, threadIndex] {
+        ScopedNoise scopedNoise{noise};
+        graph.process(threadIndex);
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    isPassed =
+      check(std::all_of(numRuns.begin(), numRuns.end(), [](int n) { return n == 1; }),
+            "Every task must run exactly once")
+      && check(depths == expectedDepths, "Tasks must run after their predecessors");
+  }
+
+  return isPassed;
+}
+
+struct Test
+{
+  const char* pName;
+  std::function<bool(SignalNoise&)> run;
+};
+
+} // namespace
+
+int main()
+{
+  const Test tests[] = {
+    {"ForkJoinBarrier", testForkJoinBarrier},
+    {"Semaphore handoff", testSemaphoreHandoff},
+    {"Semaphore counting", testSemaphoreCounting},
+    {"TaskGraph", testTaskGraph},
+  };
+
+  SignalNoise noise;
+  int numFailures = 0;
+  for (const auto& test : tests)
+  {
+    const auto startTime = std::chrono::steady_clock::now();
+    const auto isPassed = test.run(noise);
+    const auto duration =
+      std::chrono::duration<double>{std::chrono::steady_clock::now() - startTime};
+    std::printf("%s %s (%.2f s)\n", isPassed ? "PASS" : "FAIL", test.pName,
+                duration.count());
+    std::fflush(stdout);
+    numFailures += isPassed ? 0 : 1;
+  }
+
+  return numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2019 Ableton AG, Berlin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*! Renders ParallelSineBank with each kernel and tile size and compares the output to
+ * Kernel::reference, which renders each partial with std::sin().
+ */
+
+#include "Constants.hpp"
+#include "ParallelSineBank.hpp"
+#include "Partial.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+using Kernel = ParallelSineBank::Kernel;
+
+constexpr auto kSampleRate = 48000.0f;
+constexpr auto kNumFramesToRender = 4096;
+
+/*! The largest allowed difference from the reference output, relative to the peak level
+ * of the reference output.
+ *
+ * The reference kernel accumulates each partial's phase in single precision, so its
+ * phases drift by about 2e-4 of a radian over kNumFramesToRender frames. The quadrature
+ * and harmonic stack kernels advance phases analytically at the end of each buffer and
+ * don't share that drift. The harmonic stack kernel additionally multiplies the rounding
+ * error of the fundamental's rotation by the harmonic number within a buffer.
+ */
+double maxRelativeError(const Kernel kernel)
+{
+  switch (kernel)
+  {
+  case Kernel::reference:
+    return 0.0;
+
+  case Kernel::vectorized:
+    return 1.0e-5;
+
+  case Kernel::quadrature:
+    return 1.0e-3;
+
+  case Kernel::harmonicStack:
+    return 5.0e-3;
+  }
+
+  return 0.0;
+}
+
+struct TestCase
+{
+  Kernel kernel;
+  int numHarmonics;
+  int bufferSize;
+  int tileSize;
+};
+
+const char* kernelName(const Kernel kernel)
+{
+  switch (kernel)
+  {
+  case Kernel::reference:
+    return "reference";
+
+  case Kernel::vectorized:
+    return "vectorized";
+
+  case Kernel::quadrature:
+    return "quadrature";
+
+  case Kernel::harmonicStack:
+    return "harmonicStack";
+  }
+
+  return "unknown";
+}
+
+//! A few detuned saws with numHarmonics harmonics each
+std::vector<HarmonicStack> generateSaws(const int numHarmonics)
+{
+  constexpr auto kNumSaws = 3;
+  constexpr auto kAmp = 1.0f / kNumSaws;
+
+  // generateSaw() adds all harmonics below the Nyquist frequency
+  const auto frequency = kSampleRate / 2.0f / (float(numHarmonics) + 0.5f);
+  std::vector<HarmonicStack> result;
+  for (int sawIndex = 0; sawIndex < kNumSaws; ++sawIndex)
+  {
+    const auto pan = float(sawIndex) / (kNumSaws - 1) * 2.0f - 1.0f;
+    const auto detune = 1.0f + 0.001f * float(sawIndex);
+    result.push_back(
+      generateSaw(kSampleRate, kAmp, kAmpSmoothingDuration, pan, frequency * detune));
+  }
+  return randomizePhases(result, 0);
+}
+
+std::vector<float> render(const std::vector<HarmonicStack>& saws,
+                          const Kernel kernel,
+                          const int bufferSize,
+                          const int tileSize)
+{
+  ParallelSineBank sineBank;
+  sineBank.setMaxNumThreads(1);
+  sineBank.setKernel(kernel);
+  sineBank.setTileSize(tileSize);
+  sineBank.setPartials(toPartials(saws));
+  sineBank.setHarmonicStacks(saws);
+
+  std::vector<float> result;
+  std::vector<float> left(bufferSize);
+  std::vector<float> right(bufferSize);
+  for (int frameIndex = 0; frameIndex < kNumFramesToRender; frameIndex += bufferSize)
+  {
+    const auto numFrames = std::min(bufferSize, kNumFramesToRender - frameIndex);
+    std::fill(left.begin(), left.end(), 0.0f);
+    std::fill(right.begin(), right.end(), 0.0f);
+
+    sineBank.prepare(sineBank.numPartials(), numFrames);
+    sineBank.process(0, numFrames);
+    sineBank.mixTo({left.data(), right.data()}, numFrames);
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+      result.push_back(left[i]);
+      result.push_back(right[i]);
+    }
+  }
+  return result;
+}
+
+bool runTest(const TestCase& test)
+{
+  const auto saws = generateSaws(test.numHarmonics);
+  const auto expected = render(saws, Kernel::reference, test.bufferSize, test.bufferSize);
+  const auto actual = render(saws, test.kernel, test.bufferSize, test.tileSize);
+
+  double peakLevel = 0.0;
+  double maxError = 0.0;
+  for (size_t i = 0; i < expected.size(); ++i)
+  {
+    peakLevel = std::max(peakLevel, double(std::fabs(expected[i])));
+    maxError = std::max(maxError, double(std::fabs(actual[i] - expected[i])));
+  }
+  const auto relativeError = peakLevel > 0.0 ? maxError / peakLevel : maxError;
+  const auto isPassed = peakLevel > 0.0 && relativeError <= maxRelativeError(test.kernel);
+
+  std::printf("%s %-13s harmonics %3d buffer size %4d tile size %4d: error %.2e\n",
+              isPassed ? "PASS" : "FAIL", kernelName(test.kernel), test.numHarmonics,
+              test.bufferSize, test.tileSize, relativeError);
+  return isPassed;
+}
+
+} // namespace
+
+int main()
+{
+  int numFailures = 0;
+  for (const auto kernel :
+       {Kernel::reference, Kernel::vectorized, Kernel::quadrature, Kernel::harmonicStack})
+  {
+    for (const auto numHarmonics : {1, 7, 8, 9, 100})
+    {
+      for (const auto bufferSize : {16, 17, 128, 1024})
+      {
+        for (const auto tileSize : {1, 16, 64, bufferSize})
+        {
+          if (!runTest({kernel, numHarmonics, bufferSize, tileSize}))
+          {
+            ++numFailures;
+          }
+        }
+      }
+    }
+  }
+
+  return numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}